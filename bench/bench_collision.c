@@ -0,0 +1,46 @@
+#include "bench_util.h"
+#include "collision.h"
+#include "list.h"
+#include "vector.h"
+#include <stdio.h>
+
+const double COLLISION_RADIUS = 50.0;
+
+typedef struct collision_bench {
+    list_t *shape1;
+    list_t *shape2;
+} collision_bench_t;
+
+static void find_collision_ops(void *aux, size_t ops) {
+    collision_bench_t *bench = aux;
+    size_t collided = 0;
+    for (size_t i = 0; i < ops; i++) {
+        collided += find_collision(bench->shape1, bench->shape2).collided;
+    }
+    bench_consume(collided);
+}
+
+// Overlapping shapes run every axis; separated ones can stop at the first
+static void run_pair(size_t sides1, size_t sides2, double distance, const char *label) {
+    collision_bench_t bench = {
+        .shape1 = bench_polygon(sides1, COLLISION_RADIUS, VEC_ZERO),
+        .shape2 = bench_polygon(sides2, COLLISION_RADIUS, (vector_t){.x = distance, .y = 10.0}),
+    };
+    char name[64];
+    snprintf(name, sizeof(name), "find_collision/%zux%zu/%s", sides1, sides2, label);
+    bench_run(name, find_collision_ops, &bench);
+    list_free(bench.shape1);
+    list_free(bench.shape2);
+}
+
+int main(int argc, char **argv) {
+    bench_init(argc, argv, "collision");
+
+    const size_t pairs[][2] = {{4, 4}, {16, 16}, {64, 64}, {4, 64}};
+    for (size_t i = 0; i < sizeof(pairs) / sizeof(pairs[0]); i++) {
+        run_pair(pairs[i][0], pairs[i][1], COLLISION_RADIUS, "overlapping");
+        run_pair(pairs[i][0], pairs[i][1], 3 * COLLISION_RADIUS, "separated");
+    }
+
+    return bench_finish();
+}
@@ -0,0 +1,61 @@
+#include "bench_util.h"
+#include "list.h"
+#include <stdint.h>
+#include <stdlib.h>
+
+const size_t BENCH_LIST_SIZE = 1024;
+
+// The benchmarks store the same pointer many times, so nothing is freed
+static void no_free(void *value) {
+}
+
+static void list_add_ops(void *aux, size_t ops) {
+    list_t *list = list_init(4, no_free);
+    for (size_t i = 0; i < ops; i++) {
+        list_add(list, aux);
+    }
+    list_free(list);
+}
+
+static void list_get_ops(void *aux, size_t ops) {
+    list_t *list = aux;
+    size_t size = list_size(list);
+    uintptr_t sum = 0;
+    for (size_t i = 0; i < ops; i++) {
+        sum += (uintptr_t)list_get(list, (i * 7) % size);
+    }
+    bench_consume(sum);
+}
+
+// Each op removes the last element and adds it back
+static void list_remove_back_ops(void *aux, size_t ops) {
+    list_t *list = aux;
+    for (size_t i = 0; i < ops; i++) {
+        list_add(list, list_remove(list, list_size(list) - 1));
+    }
+}
+
+// Each op removes the first element, shifting the rest, and adds it back
+static void list_remove_front_ops(void *aux, size_t ops) {
+    list_t *list = aux;
+    for (size_t i = 0; i < ops; i++) {
+        list_add(list, list_remove(list, 0));
+    }
+}
+
+int main(int argc, char **argv) {
+    bench_init(argc, argv, "list");
+
+    list_t *list = list_init(BENCH_LIST_SIZE, no_free);
+    for (size_t i = 0; i < BENCH_LIST_SIZE; i++) {
+        list_add(list, (void *)(i + 1));
+    }
+
+    bench_run("list_add", list_add_ops, list);
+    bench_run("list_get/1024", list_get_ops, list);
+    bench_run("list_remove_back+add/1024", list_remove_back_ops, list);
+    bench_run("list_remove_front+add/1024", list_remove_front_ops, list);
+
+    list_free(list);
+    return bench_finish();
+}
@@ -0,0 +1,56 @@
+#include "bench_util.h"
+#include "list.h"
+#include "polygon.h"
+#include "vector.h"
+#include <stdio.h>
+
+const size_t POLYGON_SIDES[] = {4, 16, 64};
+const size_t NUM_POLYGON_SIDES = sizeof(POLYGON_SIDES) / sizeof(POLYGON_SIDES[0]);
+
+static void polygon_centroid_ops(void *aux, size_t ops) {
+    list_t *polygon = aux;
+    double sum = 0.0;
+    for (size_t i = 0; i < ops; i++) {
+        vector_t centroid = polygon_centroid(polygon);
+        sum += centroid.x + centroid.y;
+    }
+    bench_consume(sum);
+}
+
+static void polygon_area_ops(void *aux, size_t ops) {
+    list_t *polygon = aux;
+    double sum = 0.0;
+    for (size_t i = 0; i < ops; i++) {
+        sum += polygon_area(polygon);
+    }
+    bench_consume(sum);
+}
+
+// Rotates about the origin, so the polygon stays the same size and place
+static void polygon_rotate_ops(void *aux, size_t ops) {
+    list_t *polygon = aux;
+    for (size_t i = 0; i < ops; i++) {
+        polygon_rotate(polygon, 0.01, VEC_ZERO);
+    }
+}
+
+int main(int argc, char **argv) {
+    bench_init(argc, argv, "polygon");
+
+    char name[64];
+    for (size_t i = 0; i < NUM_POLYGON_SIDES; i++) {
+        size_t sides = POLYGON_SIDES[i];
+        list_t *polygon = bench_polygon(sides, 50.0, (vector_t){.x = 10.0, .y = 20.0});
+
+        snprintf(name, sizeof(name), "polygon_centroid/%zu", sides);
+        bench_run(name, polygon_centroid_ops, polygon);
+        snprintf(name, sizeof(name), "polygon_area/%zu", sides);
+        bench_run(name, polygon_area_ops, polygon);
+        snprintf(name, sizeof(name), "polygon_rotate/%zu", sides);
+        bench_run(name, polygon_rotate_ops, polygon);
+
+        list_free(polygon);
+    }
+
+    return bench_finish();
+}
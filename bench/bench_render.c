@@ -0,0 +1,65 @@
+#include "bench_util.h"
+#include "body.h"
+#include "color.h"
+#include "list.h"
+#include "render_batch.h"
+#include "scene.h"
+#include "sdl_wrapper.h"
+#include "vector.h"
+#include <stdio.h>
+#include <SDL2/SDL.h>
+
+const vector_t RENDER_WINDOW = {.x = 1000, .y = 500};
+const double RENDER_BODY_RADIUS = 8.0;
+const size_t RENDER_BODIES[] = {16, 256, 1024};
+const size_t NUM_RENDER_BODIES = sizeof(RENDER_BODIES) / sizeof(RENDER_BODIES[0]);
+
+static void sdl_render_scene_ops(void *aux, size_t ops) {
+    scene_t *scene = aux;
+    for (size_t i = 0; i < ops; i++) {
+        sdl_render_scene(scene);
+    }
+}
+
+static void render_batch_scene_ops(void *aux, size_t ops) {
+    scene_t *scene = aux;
+    for (size_t i = 0; i < ops; i++) {
+        render_batch_scene(scene);
+    }
+}
+
+// Scatters hexagons over the window
+static scene_t *make_scene(size_t num_bodies) {
+    scene_t *scene = scene_init();
+    for (size_t i = 0; i < num_bodies; i++) {
+        vector_t center = {.x = (i * 37) % (size_t)RENDER_WINDOW.x,
+                           .y = (i * 53) % (size_t)RENDER_WINDOW.y};
+        list_t *shape = bench_polygon(6, RENDER_BODY_RADIUS, center);
+        rgb_color_t color = {.r = (i % 3) / 2.0, .g = (i % 5) / 4.0, .b = (i % 7) / 6.0};
+        scene_add_body(scene, body_init(shape, 1.0, color));
+    }
+    return scene;
+}
+
+int main(int argc, char **argv) {
+    bench_init(argc, argv, "render");
+
+    // Null renderer: SDL's dummy video driver with the software renderer
+    SDL_setenv("SDL_VIDEODRIVER", "dummy", 1);
+    SDL_SetHint(SDL_HINT_RENDER_DRIVER, "software");
+    sdl_init(VEC_ZERO, RENDER_WINDOW);
+
+    char name[64];
+    for (size_t i = 0; i < NUM_RENDER_BODIES; i++) {
+        size_t num_bodies = RENDER_BODIES[i];
+        scene_t *scene = make_scene(num_bodies);
+        snprintf(name, sizeof(name), "sdl_render_scene/%zu", num_bodies);
+        bench_run(name, sdl_render_scene_ops, scene);
+        snprintf(name, sizeof(name), "render_batch_scene/%zu", num_bodies);
+        bench_run(name, render_batch_scene_ops, scene);
+        scene_free(scene);
+    }
+
+    render_batch_free(render_batch_shared());
+    return bench_finish();
+}
@@ -0,0 +1,70 @@
+#include "bench_util.h"
+#include "body.h"
+#include "color.h"
+#include "forces.h"
+#include "list.h"
+#include "scene.h"
+#include "vector.h"
+#include <stdio.h>
+
+const double SCENE_DT = 1e-3;
+const double SCENE_SPACING = 40.0;
+const double SCENE_BODY_RADIUS = 10.0;
+// Weak enough that the bodies barely move over a whole run
+const double SCENE_G = 1e-6;
+const double SCENE_DRAG = 1e-3;
+const size_t SCENE_BODIES[] = {16, 256, 1024};
+const size_t NUM_SCENE_BODIES = sizeof(SCENE_BODIES) / sizeof(SCENE_BODIES[0]);
+
+typedef enum { FORCES_NONE, FORCES_GRAVITY, FORCES_DRAG } scene_forces_t;
+
+static void scene_tick_ops(void *aux, size_t ops) {
+    scene_t *scene = aux;
+    for (size_t i = 0; i < ops; i++) {
+        scene_tick(scene, SCENE_DT);
+    }
+}
+
+// Lays the bodies out on a square grid; with forces, adds one creator per body
+static scene_t *make_scene(size_t num_bodies, scene_forces_t forces) {
+    scene_t *scene = scene_init();
+    size_t columns = 1;
+    while (columns * columns < num_bodies) {
+        columns++;
+    }
+    for (size_t i = 0; i < num_bodies; i++) {
+        vector_t center = {.x = (i % columns) * SCENE_SPACING, .y = (i / columns) * SCENE_SPACING};
+        list_t *shape = bench_polygon(4, SCENE_BODY_RADIUS, center);
+        scene_add_body(scene, body_init(shape, 1.0, (rgb_color_t){0.5, 0.5, 0.5}));
+    }
+    for (size_t i = 0; i < num_bodies && forces != FORCES_NONE; i++) {
+        body_t *body = scene_get_body(scene, i);
+        if (forces == FORCES_GRAVITY) {
+            create_newtonian_gravity(scene, SCENE_G, body,
+                                     scene_get_body(scene, (i + 1) % num_bodies));
+        } else {
+            create_drag(scene, SCENE_DRAG, body);
+        }
+    }
+    return scene;
+}
+
+int main(int argc, char **argv) {
+    bench_init(argc, argv, "scene");
+
+    const char *force_names[] = {"none", "gravity", "drag"};
+    char name[64];
+    for (size_t i = 0; i < NUM_SCENE_BODIES; i++) {
+        for (scene_forces_t forces = FORCES_NONE; forces <= FORCES_DRAG; forces++) {
+            size_t num_bodies = SCENE_BODIES[i];
+            size_t num_creators = forces == FORCES_NONE ? 0 : num_bodies;
+            scene_t *scene = make_scene(num_bodies, forces);
+            snprintf(name, sizeof(name), "scene_tick/N=%zu,M=%zu,%s", num_bodies, num_creators,
+                     force_names[forces]);
+            bench_run(name, scene_tick_ops, scene);
+            scene_free(scene);
+        }
+    }
+
+    return bench_finish();
+}
@@ -0,0 +1,89 @@
+#include "bench_util.h"
+#include "vector.h"
+#include <stddef.h>
+
+// Each op feeds its result into the next so the calls cannot be hoisted
+typedef struct vector_bench {
+    vector_t v;
+    vector_t w;
+} vector_bench_t;
+
+static void vec_add_ops(void *aux, size_t ops) {
+    vector_bench_t *bench = aux;
+    vector_t v = bench->v;
+    for (size_t i = 0; i < ops; i++) {
+        v = vec_add(v, bench->w);
+    }
+    bench_consume(v.x + v.y);
+}
+
+static void vec_subtract_ops(void *aux, size_t ops) {
+    vector_bench_t *bench = aux;
+    vector_t v = bench->v;
+    for (size_t i = 0; i < ops; i++) {
+        v = vec_subtract(v, bench->w);
+    }
+    bench_consume(v.x + v.y);
+}
+
+static void vec_negate_ops(void *aux, size_t ops) {
+    vector_bench_t *bench = aux;
+    vector_t v = bench->v;
+    for (size_t i = 0; i < ops; i++) {
+        v = vec_negate(v);
+    }
+    bench_consume(v.x + v.y);
+}
+
+static void vec_multiply_ops(void *aux, size_t ops) {
+    vector_bench_t *bench = aux;
+    vector_t v = bench->v;
+    for (size_t i = 0; i < ops; i++) {
+        v = vec_multiply(-1.0, v);
+    }
+    bench_consume(v.x + v.y);
+}
+
+static void vec_dot_ops(void *aux, size_t ops) {
+    vector_bench_t *bench = aux;
+    double sum = 0.0;
+    for (size_t i = 0; i < ops; i++) {
+        sum += vec_dot(bench->v, bench->w);
+        bench->v.x = sum * 1e-9;
+    }
+    bench_consume(sum);
+}
+
+static void vec_cross_ops(void *aux, size_t ops) {
+    vector_bench_t *bench = aux;
+    double sum = 0.0;
+    for (size_t i = 0; i < ops; i++) {
+        sum += vec_cross(bench->v, bench->w);
+        bench->v.x = sum * 1e-9;
+    }
+    bench_consume(sum);
+}
+
+static void vec_rotate_ops(void *aux, size_t ops) {
+    vector_bench_t *bench = aux;
+    vector_t v = bench->v;
+    for (size_t i = 0; i < ops; i++) {
+        v = vec_rotate(v, 0.01);
+    }
+    bench_consume(v.x + v.y);
+}
+
+int main(int argc, char **argv) {
+    bench_init(argc, argv, "vector");
+
+    vector_bench_t bench = {.v = {.x = 3.0, .y = 4.0}, .w = {.x = 1e-6, .y = -2e-6}};
+    bench_run("vec_add", vec_add_ops, &bench);
+    bench_run("vec_subtract", vec_subtract_ops, &bench);
+    bench_run("vec_negate", vec_negate_ops, &bench);
+    bench_run("vec_multiply", vec_multiply_ops, &bench);
+    bench_run("vec_dot", vec_dot_ops, &bench);
+    bench_run("vec_cross", vec_cross_ops, &bench);
+    bench_run("vec_rotate", vec_rotate_ops, &bench);
+
+    return bench_finish();
+}
@@ -8,6 +8,15 @@
 #include "state.h"
 #include "vector.h"
 #include "platform.h"
+#include "texture_cache.h"
+#include "render_batch.h"
+#include "slot_map.h"
+#include "broadphase.h"
+#include "fixed_step.h"
+#include "arena.h"
+#include "frame_alloc.h"
+#include "profile.h"
+#include "perf_overlay.h"
 #include <assert.h>
 #include <math.h>
 #include <time.h>
@@ -18,6 +27,9 @@
 #include <SDL2/SDL_image.h>
 #include <emscripten.h>
 
+// Defined in forces.c
+void double_jump_collision(body_t *player, body_t *powerup, vector_t axis, void *aux);
+
 // Constants for screen width and height
 const vector_t WINDOW_PLATFORMER = (vector_t){.x = 1000, .y = 500};
 const vector_t CENTER_PLATFORMER = (vector_t){.x = 500, .y = 250};
@@ -43,6 +55,11 @@ const rgb_color_t MID_SCORE_COLOR = {0.0, 0.0, 1.0}; //dark blue
 const rgb_color_t TOP_SCORE_COLOR = {0.627, 0.125, 0.941}; //purple
 const size_t JUMP_TIME = 5;
 const double GAMMA = 50;
+// Players and platforms are simulated at 120 Hz whatever the frame rate
+const double PLATFORMER_STEP_DT = 1.0 / 120.0;
+const size_t PLATFORMER_MAX_STEPS = 8;
+// Chunk size of the arena a session's state and players live in
+const size_t PLATFORMER_ARENA_CHUNK = 4 * 1024;
 const vector_t WIND_VECTOR = {500, -500};
 const int WIND_MODULUS = 5; //This is modulused with the current time to
 //see if the wind system is activated, higher number = less frequent
@@ -64,7 +81,7 @@ const double TIME_DELAY = 2;
 
 // Structure for players
 typedef struct player_struct{
-    body_t *player;
+    body_handle_t player;
     size_t score;
     size_t lives;
     bool is_alive;
@@ -78,19 +95,24 @@ typedef struct player_struct{
 // Structure for game state
 typedef struct platformer_state {
     scene_t *scene;
-    body_t *player;
+    slot_map_t *bodies;
+    broadphase_t *broadphase;
+    fixed_step_t *stepper;
+    arena_t *arena;
+    body_handle_t player;
+    body_handle_t powerup;
     player_struct_t *player_1;
     player_struct_t *player_2;
     size_t round_number;
     bool wind; //bool for if wind is active
     bool game_over;
 
-    //pointer to textures
-    SDL_Texture *round1_texture; 
-    SDL_Texture *round2_texture;
-    SDL_Texture *round3_texture;
-    SDL_Texture *gameover_texture;
-    SDL_Texture *wind_texture;
+    //handles to cached textures
+    texture_handle_t *round1_texture;
+    texture_handle_t *round2_texture;
+    texture_handle_t *round3_texture;
+    texture_handle_t *gameover_texture;
+    texture_handle_t *wind_texture;
 } platformer_state_t;
 
 // Structure for game states
@@ -112,26 +134,28 @@ body_t *draw_platform(SDL_Renderer *platformer_renderer, scene_t *scene, vector_
     return platform;
 }
 
-body_t *draw_player(SDL_Renderer *platformer_renderer, scene_t *scene, vector_t size, rgb_color_t color) {
+body_handle_t draw_player(SDL_Renderer *platformer_renderer, platformer_state_t *state, vector_t size, rgb_color_t color) {
     list_t *shape = platform_generate_rectangle(size.x, size.y, WINDOW_PLATFORMER.x / 3, 300, TWO_PI_PLATFORMER);
-    body_t *player = body_init(shape, PLATFORM_MASS, color);
+    body_handle_t handle = slot_map_body_init(state->bodies, shape, PLATFORM_MASS, color);
+    body_t *player = slot_map_get(state->bodies, handle);
     body_set_velocity(player, VEC_ZERO);
     body_set_acceleration(player, PLAYER_ACCELERATION);
-    scene_add_body(scene, player);
+    scene_add_body(state->scene, player);
     platform_draw(platformer_renderer, player);
 
-    return player;
+    return handle;
 }
 
-void draw_falling_rectangles(SDL_Renderer *platformer_renderer, scene_t *scene, body_t *player) {
+void draw_falling_rectangles(SDL_Renderer *platformer_renderer, scene_t *scene, broadphase_t *broadphase, body_t *player) {
+    frame_allow_malloc();
     double random_x = (PLATFORM_SIZE.x / 2) + ((rand() % (int)(WINDOW_PLATFORMER.x - PLATFORM_SIZE.x)));
     body_t *platform = draw_platform(platformer_renderer, scene, PLATFORM_SIZE, PLATFORM_COLOR, random_x, WINDOW_PLATFORMER.y - PLATFORM_SIZE.y);
 
     body_set_velocity(platform, TEST_VELOCITY);
-    create_platform_for_body(scene, platform, player);
+    create_platform_for_body(broadphase, platform, player);
 }
 
-body_t *draw_powerup(scene_t *scene, double center_x, double center_y) {
+body_handle_t draw_powerup(platformer_state_t *state, double center_x, double center_y) {
     double curr_angle = 0;
     double vert_angle = TWO_PI_PLATFORMER / POWERUP_GRADIENT_SIZE;
     double x;
@@ -151,16 +175,17 @@ body_t *draw_powerup(scene_t *scene, double center_x, double center_y) {
 
     char* powerup_label = malloc(sizeof(char) * 5);
     strcpy(powerup_label, "pow");
-    body_t *powerup = 
-        body_init_with_info(vertices, POWERUP_MASS, POWERUP_COLOR, powerup_label, free);
-    scene_add_body(scene, powerup);
+    body_handle_t powerup = 
+        slot_map_body_init_with_info(state->bodies, vertices, POWERUP_MASS, POWERUP_COLOR, powerup_label, free);
+    scene_add_body(state->scene, slot_map_get(state->bodies, powerup));
     return powerup;
 }
 
 
-void create_double_jump(scene_t *scene, double center_x, double center_y, body_t *player) {
-    body_t *powerup = draw_powerup(scene, center_x, center_y);
-    create_double_jump_collision(scene, player, powerup);
+void create_double_jump(platformer_state_t *state, double center_x, double center_y, body_handle_t player) {
+    state->powerup = draw_powerup(state, center_x, center_y);
+    broadphase_add_collision(state->broadphase, slot_map_get(state->bodies, player),
+                             slot_map_get(state->bodies, state->powerup), double_jump_collision, NULL, NULL);
 }
 
 void wind(body_t *player) {
@@ -177,28 +202,28 @@ void on_key_platformer(char key, key_event_type_t type, double held_time, state_
   if (type == KEY_PRESSED) {
     switch (key) {
         case LEFT_ARROW:
-            body_set_velocity(state->player_1->player, (vector_t){-60, 0});
+            body_set_velocity(slot_map_get(state->bodies, state->player_1->player), (vector_t){-60, 0});
             break;
         case SDLK_a:
-            body_set_velocity(state->player_2->player, (vector_t){-60, 0});
+            body_set_velocity(slot_map_get(state->bodies, state->player_2->player), (vector_t){-60, 0});
             break;
         case RIGHT_ARROW:
-            body_set_velocity(state->player_1->player, (vector_t){60, 0});
+            body_set_velocity(slot_map_get(state->bodies, state->player_1->player), (vector_t){60, 0});
             break;
         case SDLK_d:
-            body_set_velocity(state->player_2->player, (vector_t){60, 0});
+            body_set_velocity(slot_map_get(state->bodies, state->player_2->player), (vector_t){60, 0});
             break;
         case DOWN_ARROW:
-            body_set_velocity(state->player_1->player, (vector_t){0, -60});
+            body_set_velocity(slot_map_get(state->bodies, state->player_1->player), (vector_t){0, -60});
             break;
         case SDLK_s:
-            body_set_velocity(state->player_2->player, (vector_t){0, -60});
+            body_set_velocity(slot_map_get(state->bodies, state->player_2->player), (vector_t){0, -60});
             break;
         case UP_ARROW:
-            body_set_velocity(state->player_1->player, (vector_t){0, 60});
+            body_set_velocity(slot_map_get(state->bodies, state->player_1->player), (vector_t){0, 60});
             break;
         case SDLK_w:
-            body_set_velocity(state->player_2->player, (vector_t){0, 60});
+            body_set_velocity(slot_map_get(state->bodies, state->player_2->player), (vector_t){0, 60});
             break;
     }
   }
@@ -212,23 +237,30 @@ platformer_state_t *platformer_init() {
 
     platformer_renderer = sdl_return_renderer();
 
-    platformer_state_t *state = malloc(sizeof(platformer_state_t));
-    assert(state != NULL);
+    // Everything the session allocates itself goes in its arena
+    arena_t *arena = arena_init(PLATFORMER_ARENA_CHUNK);
+    platformer_state_t *state = arena_alloc(arena, sizeof(platformer_state_t));
+    state->arena = arena;
 
     scene_t *scene = scene_init();
+    state->scene = scene;
+    state->bodies = slot_map_init(10);
+    // Platforms pile up over a round, so bucket them by size
+    state->broadphase = broadphase_init(scene, BROADPHASE_UNIFORM_GRID, 2 * PLATFORM_SIZE.x);
+    state->stepper = fixed_step_init(PLATFORMER_STEP_DT, PLATFORMER_MAX_STEPS);
     state -> round_number = 0;
     state -> wind = false;
 
-    body_t *player = draw_player(platformer_renderer, scene, PLATFORM_SIZE, BODY_COLOR_PLATFORMER);
-    player_struct_t *player_1_struct = malloc(sizeof(player_struct_t));
+    body_handle_t player = draw_player(platformer_renderer, state, PLATFORM_SIZE, BODY_COLOR_PLATFORMER);
+    player_struct_t *player_1_struct = arena_alloc(arena, sizeof(player_struct_t));
     player_1_struct->player = player;
     player_1_struct->lives = PLAYER_LIVES;
     player_1_struct->score = 0;
     player_1_struct->is_alive = true;
     state->player_1 = player_1_struct;
 
-    body_t *player2 = draw_player(platformer_renderer, scene, PLATFORM_SIZE, BODY_COLOR_PLATFORMER);
-    player_struct_t *player_2_struct = malloc(sizeof(player_struct_t));
+    body_handle_t player2 = draw_player(platformer_renderer, state, PLATFORM_SIZE, BODY_COLOR_PLATFORMER);
+    player_struct_t *player_2_struct = arena_alloc(arena, sizeof(player_struct_t));
     player_2_struct->player = player2;
     player_2_struct->lives = PLAYER_LIVES;
     player_2_struct->score = 0;
@@ -236,28 +268,26 @@ platformer_state_t *platformer_init() {
     state->player_2 = player_2_struct;
 
     
-    create_double_jump(scene, 150, 150, player);
-    state->scene = scene;
+    create_double_jump(state, 150, 150, player);
     state->player = player;
     state->game_over = false;
 
-    //load textures
-    state->round1_texture = IMG_LoadTexture(platformer_renderer, 
-    "assets/round1.png");
-    state->round2_texture = IMG_LoadTexture(platformer_renderer, 
-    "assets/round2.png");
-    state->round3_texture = IMG_LoadTexture(platformer_renderer, 
-    "assets/round3.png");
-    state->gameover_texture = IMG_LoadTexture(platformer_renderer, 
-    "assets/gameover.png");
-    state->wind_texture = IMG_LoadTexture(platformer_renderer, 
-    "assets/wind.png");
+    //load textures, decoding them in parallel
+    texture_cache_t *cache = texture_cache_shared();
+    const char *textures[] = {"assets/round1.png", "assets/round2.png", "assets/round3.png",
+                              "assets/gameover.png", "assets/wind.png"};
+    texture_cache_preload(cache, textures, 5);
+    state->round1_texture = texture_cache_acquire(cache, "assets/round1.png");
+    state->round2_texture = texture_cache_acquire(cache, "assets/round2.png");
+    state->round3_texture = texture_cache_acquire(cache, "assets/round3.png");
+    state->gameover_texture = texture_cache_acquire(cache, "assets/gameover.png");
+    state->wind_texture = texture_cache_acquire(cache, "assets/wind.png");
 
     sdl_on_key(on_key_platformer);
     return state;
 }
 
-void redraw_player(SDL_Renderer *platformer_renderer, scene_t *scene, vector_t size, player_struct_t *player_struct) {
+void redraw_player(SDL_Renderer *platformer_renderer, platformer_state_t *state, vector_t size, player_struct_t *player_struct) {
     rgb_color_t color = ZERO_SCORE_COLOR;
     if(player_struct->score == 1){
         color = MID_SCORE_COLOR;
@@ -266,25 +296,24 @@ void redraw_player(SDL_Renderer *platformer_renderer, scene_t *scene, vector_t s
         color = TOP_SCORE_COLOR;
     }
     list_t *shape = platform_generate_rectangle(size.x, size.y, WINDOW_PLATFORMER.x / 3, 300, TWO_PI_PLATFORMER);
-    body_t *player = body_init(shape, PLATFORM_MASS, color);
+    player_struct->player = slot_map_body_init(state->bodies, shape, PLATFORM_MASS, color);
+    body_t *player = slot_map_get(state->bodies, player_struct->player);
     body_set_velocity(player, VEC_ZERO);
     body_set_acceleration(player, PLAYER_ACCELERATION);
-    scene_add_body(scene, player);
+    scene_add_body(state->scene, player);
     platform_draw(platformer_renderer, player);
-
-    player_struct->player = player;
 }
 
 platformer_state_t *emscripten_new_game_init(platformer_state_t *state, player_struct_t *player_1, player_struct_t *player_2){
-    scene_t *scene = state->scene;
+    frame_allow_malloc();
     sdl_clear();
 
     platformer_renderer = sdl_return_renderer();
 
-    redraw_player(platformer_renderer, scene, PLATFORM_SIZE, player_1);
-    redraw_player(platformer_renderer, scene, PLATFORM_SIZE, player_2);
+    redraw_player(platformer_renderer, state, PLATFORM_SIZE, player_1);
+    redraw_player(platformer_renderer, state, PLATFORM_SIZE, player_2);
 
-    create_double_jump(scene, 150, 150, state->player_1->player);
+    create_double_jump(state, 150, 150, state->player_1->player);
     state->player = state->player_1->player;
 
     return state;
@@ -296,7 +325,6 @@ platformer_state_t *emscripten_new_game_init(platformer_state_t *state, player_s
 void update_player(platformer_state_t *state, size_t player_num){
     player_struct_t *player = NULL;
     player_struct_t *other = NULL;
-    scene_t *scene = state->scene;
     if(player_num == 1){
         player = state->player_1;
         other = state->player_2;
@@ -306,25 +334,15 @@ void update_player(platformer_state_t *state, size_t player_num){
         other = state->player_1;
     }
 
-    body_t *body = player->player;
-    body_t *oBody = other->player;
+    body_t *body = slot_map_get(state->bodies, player->player);
     if(get_window_position(body_get_centroid(body), CENTER_PLATFORMER).y >=
           WINDOW_PLATFORMER.y){
         other->score = other->score + 1;
-        body_remove(body);
-        body_remove(oBody);
-
-        size_t body_count = scene_bodies(scene);
-        for (size_t i = 0; i < body_count; i++) {
-            body_t *body = scene_get_body(scene, i);
-            list_t *shape = body_get_shape(body);
-            char* info = (char*)body_get_info(body);
-            if(info && !strcmp(info, "pow")){
-               scene_remove_body(scene, i);
-               body_count --;
-               i --;
-            }
-        }
+        slot_map_remove(state->bodies, player->player);
+        slot_map_remove(state->bodies, other->player);
+
+        // No-op if a player already picked the powerup up
+        slot_map_remove(state->bodies, state->powerup);
         state -> round_number += 1;
         emscripten_new_game_init(state, state->player_1, state->player_2);
     }
@@ -347,20 +365,58 @@ void update_player(platformer_state_t *state, size_t player_num){
 void platformer_end(platformer_state_t *state) {
     state->game_over = true;
     SDL_RenderClear(platformer_renderer);
-    SDL_DestroyTexture(state->round1_texture);
-    SDL_DestroyTexture(state->round2_texture);
-    SDL_DestroyTexture(state->round3_texture);
-    SDL_DestroyTexture(state->gameover_texture);
-    SDL_DestroyTexture(state->wind_texture);
+    texture_cache_t *cache = texture_cache_shared();
+    texture_cache_release(cache, state->round1_texture);
+    texture_cache_release(cache, state->round2_texture);
+    texture_cache_release(cache, state->round3_texture);
+    texture_cache_release(cache, state->gameover_texture);
+    texture_cache_release(cache, state->wind_texture);
 
     return;
 }
 
-void platformer_main(platformer_state_t *state, double game_dt) {
+// Advances the simulation by one fixed step
+static void platformer_step(platformer_state_t *state, double dt) {
+    PROFILE_ZONE("platformer_step");
     scene_t *scene = state->scene;
-    double dt = game_dt;
     time_step += dt;
 
+    //mark old platforms; scene_tick frees every removed body and its forces
+    for(size_t i = 1; i < scene_bodies(scene); i++){
+        body_t *body = scene_get_body(scene, i);
+        double x = get_window_position(body_get_centroid(body), CENTER_PLATFORMER).x;
+        if(x > 20000 || x < -20000){
+            body_remove(body);
+        }
+    }
+
+    //check player behavior 
+    update_player(state, 1);
+    update_player(state, 2);
+
+    // Generate new platforms before the tick, so a new body never reuses
+    // the address of one the tick frees (see fixed_step.h)
+    if (time_step > TIME_DELAY) {
+        body_t *player = slot_map_get(state->bodies, state->player);
+        draw_falling_rectangles(platformer_renderer, scene, state->broadphase, player);
+        time_step = 0;
+        wind(player);
+    }
+
+    scene_tick(scene, dt);
+}
+
+void platformer_main(platformer_state_t *state, double game_dt) {
+    PROFILE_ZONE("platformer_main");
+    scene_t *scene = state->scene;
+
+    // Run the simulation in fixed steps, then draw between the last two
+    size_t steps = fixed_step_advance(state->stepper, game_dt);
+    for (size_t i = 0; i < steps; i++) {
+        fixed_step_save(state->stepper, scene);
+        platformer_step(state, fixed_step_get_dt(state->stepper));
+    }
+
     SDL_SetRenderDrawColor(platformer_renderer, 173, 216, 230, 255);
     //set backround color
     SDL_RenderClear(platformer_renderer);
@@ -371,69 +427,42 @@ void platformer_main(platformer_state_t *state, double game_dt) {
    //Draw round number / gameover
    size_t round = state -> round_number;
    if(round < 1){
-        SDL_RenderCopy(platformer_renderer, state->round1_texture, 
-        NULL, &round_location);
+        SDL_RenderCopy(platformer_renderer, 
+        texture_handle_get(state->round1_texture), NULL, &round_location);
    } else if(round == 1){
         SDL_RenderCopy(platformer_renderer, 
-        state->round2_texture, NULL, &round_location);
+        texture_handle_get(state->round2_texture), NULL, &round_location);
    } else if(round == 2){
         SDL_RenderCopy(platformer_renderer, 
-        state->round3_texture, NULL, &round_location);
+        texture_handle_get(state->round3_texture), NULL, &round_location);
    } else{
         SDL_RenderCopy(platformer_renderer, 
-        state->gameover_texture, NULL, &gameover_location);
+        texture_handle_get(state->gameover_texture), NULL, &gameover_location);
         platformer_end(state);
    }
 
    //Draw wind
    if(state -> wind){
         SDL_RenderCopy(platformer_renderer, 
-        state->wind_texture, NULL, &wind_location);
+        texture_handle_get(state->wind_texture), NULL, &wind_location);
    }
    
-    sdl_render_scene(scene);
-    
-    scene_tick(scene, dt);
-    sdl_show();
-
-    //remove everything taged for removal
-    size_t body_count = scene_bodies(scene);
-    for (size_t i = 0; i < body_count; i++) {
-        body_t *body = scene_get_body(scene, i);
-        list_t *shape = body_get_shape(body);
-        if(body_is_removed(body)){
-            scene_remove_body(scene, i);
-            body_count --;
-            i --;
-        }
-    }
-    
-    //check player behavior 
-    update_player(state, 1);
-    update_player(state, 2);
-
-    // Generate new platforms
-    if (time_step > TIME_DELAY) {
-        draw_falling_rectangles(platformer_renderer, scene, state->player);
-        time_step = 0;
-        wind(state->player);
-    }
-
-    //remove old platforms
-    for(size_t i = 1; i < scene_bodies(scene); i++){
-        body_t *body = scene_get_body(scene, i);
-        if(get_window_position(body_get_centroid(body), CENTER_PLATFORMER).x > 20000 ||
-        get_window_position(body_get_centroid(body), CENTER_PLATFORMER).x < -20000){
-            scene_remove_body(scene, i);
-        }
-    }
+    render_batch_t *batch = render_batch_shared();
+    fixed_step_add_scene(state->stepper, batch, scene);
+    render_batch_flush(batch);
+    perf_overlay_draw(scene);
+    render_batch_present();
 }
 
 void platformer_free(platformer_state_t *state) {
+    arena_stats_t stats = arena_get_stats(state->arena);
+    SDL_Log("platformer arena: %zu bytes used at peak, %zu reserved in %zu chunks\n",
+            stats.peak_used, stats.peak_reserved, stats.chunks);
+
+    // The scene owns the bodies; the map only hears about them being freed
     scene_free(state->scene);
-    free(state->player_1->player);
-    free(state->player_1);
-    free(state->player_2->player);
-    free(state->player_2);
-    free(state);
+    slot_map_free(state->bodies);
+    fixed_step_free(state->stepper);
+    // Releases the state and both players in one go
+    arena_free(state->arena);
 }
@@ -7,6 +7,20 @@
 #include "sdl_wrapper.h"
 #include "state.h"
 #include "vector.h"
+#include "texture_cache.h"
+#include "render_batch.h"
+#include "slot_map.h"
+#include "broadphase.h"
+#include "command_buffer.h"
+#include "force_batch.h"
+#include "fixed_step.h"
+#include "arena.h"
+#include "frame_alloc.h"
+#include "layer_cache.h"
+#include "sprite_index.h"
+#include "profile.h"
+#include "perf_overlay.h"
+#include "vertex_array.h"
 #include "tanks.h"
 #include "platformer.h"
 #include <assert.h>
@@ -15,6 +29,12 @@
 #include <stdlib.h>
 
 // Constants for screen width and height
+// Mini game to start in: 0 for the hub, 1 for tanks, 2 for the platformer.
+// The native bin/tanks and bin/platformer builds set this.
+#ifndef SQUARE_START_GAME
+#define SQUARE_START_GAME 0
+#endif
+
 const vector_t WINDOW = (vector_t){.x = 1000, .y = 500};
 const vector_t CENTER = (vector_t){.x = 500, .y = 250};
 const SDL_Rect popup_location = {0, 0, 1000, 500};
@@ -24,6 +44,10 @@ const SDL_Rect mainplayer2_location = {650, 80, 200, 80};
 // Body constants
 const double TWO_PI = 2.0 * M_PI;
 const size_t RADIUS = 20;
+// Player shapes evolve with every 10 points, up to the purple square
+#define PLAYER_STAGES 7
+const vector_t PLAYER1_CENTER = (vector_t){.x = 300, .y = 250};
+const vector_t PLAYER2_CENTER = (vector_t){.x = 700, .y = 250};
 const rgb_color_t BLACK_COLOR = (rgb_color_t){.r = 0, .g = 0, .b = 0};
 const rgb_color_t GRAY_COLOR = (rgb_color_t){.r = 0.3059, .g = 0.3176, .b = 0.3412};
 const rgb_color_t PURPLE_COLOR = (rgb_color_t){.r = 150.0 / 255.0 , .g = 101.0 / 255.0, .b = 247.0 / 255.0};
@@ -33,9 +57,17 @@ SDL_Renderer *square_renderer = NULL;
 // Structure for game states
 typedef struct main_player {
     size_t score;
+    // Stage whose shape body has, normally score / 10
+    size_t stage;
     body_t *body;
 } main_player_t;
 
+// A player stage's shape around the origin, built once at startup
+typedef struct player_template {
+    vertex_array_t *shape;
+    rgb_color_t color;
+} player_template_t;
+
 typedef struct state {
     scene_t *scene;
     tanks_state_t *tanks_state;
@@ -45,6 +77,9 @@ typedef struct state {
     main_player_t player1;
     main_player_t player2;
     size_t curr_popup;
+    player_template_t player_templates[PLAYER_STAGES];
+    // The whole hub screen, redrawn on a popup change or a new player shape
+    layer_cache_t *hub_layer;
 } state_t;
 
 // Structures for tanks state
@@ -65,7 +100,7 @@ typedef struct bullet {
     size_t player_num;
     SDL_Texture *image;
     SDL_Rect location;
-    body_t *body;
+    body_handle_t body;
 } bullet_t;
 
 typedef struct crater {
@@ -96,11 +131,24 @@ typedef struct tanks_state {
     bool game_over;
     size_t counter;
     size_t winner;
+    texture_handle_t *landscape_texture;
+    texture_handle_t *atlas_texture;
+    slot_map_t *bodies;
+    body_handle_t gravity_body;
+    broadphase_t *broadphase;
+    fixed_step_t *stepper;
+    arena_t *arena;
+    layer_cache_t *ground_layer;
+    sprite_index_t *crater_index;
+    sprite_index_t *boulder_index;
+    command_buffer_t *commands;
+    force_batch_t *forces;
+    bool pending_shots[2];
 } tanks_state_t;
 
 // Structures for platformer state
 typedef struct player_struct{
-    body_t *player;
+    body_handle_t player;
     size_t score;
     size_t lives;
     bool is_alive;
@@ -113,19 +161,24 @@ typedef struct player_struct{
 
 typedef struct platformer_state {
     scene_t *scene;
-    body_t *player;
+    slot_map_t *bodies;
+    broadphase_t *broadphase;
+    fixed_step_t *stepper;
+    arena_t *arena;
+    body_handle_t player;
+    body_handle_t powerup;
     player_struct_t *player_1;
     player_struct_t *player_2;
     size_t round_number;
     bool wind; //bool for if wind is active
     bool game_over;
 
-    //pointer to textures
-    SDL_Texture *round1_texture; 
-    SDL_Texture *round2_texture;
-    SDL_Texture *round3_texture;
-    SDL_Texture *gameover_texture;
-    SDL_Texture *wind_texture;
+    //handles to cached textures
+    texture_handle_t *round1_texture;
+    texture_handle_t *round2_texture;
+    texture_handle_t *round3_texture;
+    texture_handle_t *gameover_texture;
+    texture_handle_t *wind_texture;
 } platformer_state_t;
 
 list_t *make_rect_square(SDL_Rect rect) {
@@ -156,9 +209,9 @@ list_t *make_rect_square(SDL_Rect rect) {
     return vertices;
 }
 
-body_t *make_player_body(size_t stage, size_t center_x, size_t center_y) {
+// Builds a stage's shape around (center_x, center_y) and sets its color
+list_t *make_stage_shape(size_t stage, double center_x, double center_y, rgb_color_t *color) {
     list_t *vertices;
-    rgb_color_t color;
 
     switch (stage) {
         case 0: { // Gray circle
@@ -178,7 +231,7 @@ body_t *make_player_body(size_t stage, size_t center_x, size_t center_y) {
                 curr_angle += vert_angle;
             }
 
-            color = GRAY_COLOR;
+            *color = GRAY_COLOR;
             break;
         }
         case 1: { // Gray line
@@ -197,7 +250,7 @@ body_t *make_player_body(size_t stage, size_t center_x, size_t center_y) {
             list_add(vertices, v3);
             list_add(vertices, v4);
             
-            color = GRAY_COLOR;
+            *color = GRAY_COLOR;
             break;
         }
         case 2: { // Gray top angle
@@ -222,7 +275,7 @@ body_t *make_player_body(size_t stage, size_t center_x, size_t center_y) {
             list_add(vertices, v5);
             list_add(vertices, v6);
 
-            color = GRAY_COLOR;
+            *color = GRAY_COLOR;
             break;
         }
         case 3: { // Gray triangle
@@ -239,7 +292,7 @@ body_t *make_player_body(size_t stage, size_t center_x, size_t center_y) {
             list_add(vertices, v2);
             list_add(vertices, v3);
 
-            color = GRAY_COLOR;
+            *color = GRAY_COLOR;
             break;
         }
         case 4: { // Purple triangle
@@ -256,7 +309,7 @@ body_t *make_player_body(size_t stage, size_t center_x, size_t center_y) {
             list_add(vertices, v2);
             list_add(vertices, v3);
 
-            color = PURPLE_COLOR;
+            *color = PURPLE_COLOR;
             break;
         }
         case 5: { // Purple diamond
@@ -276,7 +329,7 @@ body_t *make_player_body(size_t stage, size_t center_x, size_t center_y) {
             list_add(vertices, v3);
             list_add(vertices, v4);
 
-            color = PURPLE_COLOR;
+            *color = PURPLE_COLOR;
             break;
         }
         case 6: { // Purple square
@@ -296,12 +349,58 @@ body_t *make_player_body(size_t stage, size_t center_x, size_t center_y) {
             list_add(vertices, v3);
             list_add(vertices, v4);
 
-            color = PURPLE_COLOR;
+            *color = PURPLE_COLOR;
             break;
         }
     }
 
-    return body_init(vertices, 1.0, color);
+    return vertices;
+}
+
+void player_templates_init(player_template_t *templates) {
+    for (size_t stage = 0; stage < PLAYER_STAGES; stage++) {
+        list_t *vertices = make_stage_shape(stage, 0, 0, &templates[stage].color);
+        templates[stage].shape = vertex_array_from_list(vertices);
+        list_free(vertices);
+    }
+}
+
+void player_templates_free(player_template_t *templates) {
+    for (size_t stage = 0; stage < PLAYER_STAGES; stage++) {
+        vertex_array_free(templates[stage].shape);
+    }
+}
+
+body_t *make_player_body(player_template_t *templates, size_t stage, vector_t center) {
+    vertex_array_t *shape = templates[stage].shape;
+    list_t *vertices = list_init(shape->size, free);
+    for (size_t i = 0; i < shape->size; i++) {
+        vector_t *vertex = malloc(sizeof(vector_t));
+        assert(vertex != NULL);
+        *vertex = vec_add(shape->points[i], center);
+        list_add(vertices, vertex);
+    }
+    return body_init(vertices, 1.0, templates[stage].color);
+}
+
+size_t player_stage(main_player_t *player) {
+    size_t stage = player->score / 10;
+    return stage < PLAYER_STAGES ? stage : PLAYER_STAGES - 1;
+}
+
+// Swaps the player's body for its stage's shape if the stage changed
+void update_player_body(state_t *state, main_player_t *player, vector_t center) {
+    size_t stage = player_stage(player);
+    if (stage == player->stage) {
+        return;
+    }
+    // Only a stage change allocates; the hub otherwise reuses both bodies
+    frame_allow_malloc();
+    body_remove(player->body);
+    player->body = make_player_body(state->player_templates, stage, center);
+    player->stage = stage;
+    scene_add_body(state->scene, player->body);
+    layer_cache_invalidate(state->hub_layer);
 }
 
 void on_key_square(char key, key_event_type_t type, double held_time, state_t *state) {
@@ -333,6 +432,7 @@ void on_key_square(char key, key_event_type_t type, double held_time, state_t *s
                         state->curr_game = 2;
                         break;
                 }
+                layer_cache_invalidate(state->hub_layer);
         }
     }
 }
@@ -348,16 +448,28 @@ state_t *emscripten_init() {
     scene_t *scene = scene_init();
 
     state->scene = scene;
-    state->switch_game = false;
-    state->curr_game = 0;
-    state->curr_popup = 1;
+    state->switch_game = SQUARE_START_GAME != 0;
+    state->curr_game = SQUARE_START_GAME;
+    // Skip the popups that lead into the starting mini game
+    state->curr_popup = SQUARE_START_GAME == 0 ? 1 : SQUARE_START_GAME == 1 ? 3 : 5;
 
     // Initialize main players
     state->player1.score = 0;
     state->player2.score = 0;
 
-    state->player1.body = make_player_body(1, CENTER.x - 200, CENTER.y);
-    state->player2.body = make_player_body(2, CENTER.x + 200, CENTER.y);
+    state->hub_layer = layer_cache_init(square_renderer);
+    // Decode every popup up front and in parallel, rather than one per
+    // first frame it is shown
+    const char *hub_textures[] = {"assets/story_blurb.png", "assets/tanks_instructions.png",
+                                  "assets/press_space.png", "assets/mainplayer1.png",
+                                  "assets/mainplayer2.png", "assets/platformer_instructions.png",
+                                  "assets/winner_screen.png"};
+    texture_cache_preload(texture_cache_shared(), hub_textures, 7);
+    player_templates_init(state->player_templates);
+    state->player1.stage = 1;
+    state->player2.stage = 2;
+    state->player1.body = make_player_body(state->player_templates, 1, PLAYER1_CENTER);
+    state->player2.body = make_player_body(state->player_templates, 2, PLAYER2_CENTER);
 
     scene_add_body(scene, state->player1.body);
     scene_add_body(scene, state->player2.body);
@@ -368,6 +480,10 @@ state_t *emscripten_init() {
 }
 
 void emscripten_main(state_t *state) {
+    PROFILE_ZONE("emscripten_main");
+    // Release last frame's scratch memory
+    frame_begin();
+
     scene_t *scene = state->scene;
     double dt = time_since_last_tick();
 
@@ -375,6 +491,7 @@ void emscripten_main(state_t *state) {
 
     // Initialize mini game
     if (state->switch_game) {
+        frame_allow_malloc();
         switch (state->curr_game) {
             case 1:
                 state->tanks_state = tanks_init();
@@ -389,49 +506,58 @@ void emscripten_main(state_t *state) {
     // Run main loop of mini game
     switch (state->curr_game) {
         case 0:
-            // Draw background
-            SDL_SetRenderDrawColor(square_renderer, 185, 237, 232, 255);
+            // Show curr player bodies
+            update_player_body(state, &state->player1, PLAYER1_CENTER);
+            update_player_body(state, &state->player2, PLAYER2_CENTER);
 
-            // Clear the screen
-            SDL_RenderClear(square_renderer);
+            // Nothing on the hub moves, so it is only redrawn when invalidated
+            if (layer_cache_begin(state->hub_layer)) {
+                // Copying the bodies' shapes mallocs; with render targets
+                // only frames after an invalidation get here
+                frame_allow_malloc();
 
-            // Show curr player bodies
-            scene_remove_body(scene, 0);
-            scene_remove_body(scene, 1);
-
-            state->player1.body = make_player_body(state->player1.score / 10, CENTER.x - 200, CENTER.y);
-            state->player2.body = make_player_body(state->player2.score / 10, CENTER.x + 200, CENTER.y);
-
-            scene_add_body(scene, state->player1.body);
-            scene_add_body(scene, state->player2.body);
-
-            sdl_render_scene(scene);
-
-            // Display popup if needed
-            switch (state->curr_popup) {
-                case 1:
-                    SDL_RenderCopy(square_renderer, IMG_LoadTexture(square_renderer, "assets/story_blurb.png"), NULL, &popup_location);
-                    break;
-                case 2:
-                    SDL_RenderCopy(square_renderer, IMG_LoadTexture(square_renderer, "assets/tanks_instructions.png"), NULL, &popup_location);
-                    break;
-                case 3:
-                    SDL_RenderCopy(square_renderer, IMG_LoadTexture(square_renderer, "assets/press_space.png"), NULL, &popup_location);
-                    SDL_RenderCopy(square_renderer, IMG_LoadTexture(square_renderer, "assets/mainplayer1.png"), NULL, &mainplayer1_location);
-                    SDL_RenderCopy(square_renderer, IMG_LoadTexture(square_renderer, "assets/mainplayer2.png"), NULL, &mainplayer2_location);
-                    break;
-                case 4:
-                    SDL_RenderCopy(square_renderer, IMG_LoadTexture(square_renderer, "assets/platformer_instructions.png"), NULL, &popup_location);
-                    break;
-                case 6:
-                    SDL_RenderCopy(square_renderer, IMG_LoadTexture(square_renderer, "assets/winner_screen.png"), NULL, &popup_location);
-                    SDL_RenderCopy(square_renderer, IMG_LoadTexture(square_renderer, "assets/mainplayer1.png"), NULL, &mainplayer1_location);
-                    SDL_RenderCopy(square_renderer, IMG_LoadTexture(square_renderer, "assets/mainplayer2.png"), NULL, &mainplayer2_location);
-                    break;
+                // Draw background
+                SDL_SetRenderDrawColor(square_renderer, 185, 237, 232, 255);
+
+                // Clear the screen
+                SDL_RenderClear(square_renderer);
+
+                // Draw the bodies in one batch, under the popups
+                render_batch_t *batch = render_batch_shared();
+                render_batch_add_scene(batch, scene);
+                render_batch_flush(batch);
+
+                // Display popup if needed
+                texture_cache_t *cache = texture_cache_shared();
+                switch (state->curr_popup) {
+                    case 1:
+                        SDL_RenderCopy(square_renderer, texture_cache_get(cache, "assets/story_blurb.png"), NULL, &popup_location);
+                        break;
+                    case 2:
+                        SDL_RenderCopy(square_renderer, texture_cache_get(cache, "assets/tanks_instructions.png"), NULL, &popup_location);
+                        break;
+                    case 3:
+                        SDL_RenderCopy(square_renderer, texture_cache_get(cache, "assets/press_space.png"), NULL, &popup_location);
+                        SDL_RenderCopy(square_renderer, texture_cache_get(cache, "assets/mainplayer1.png"), NULL, &mainplayer1_location);
+                        SDL_RenderCopy(square_renderer, texture_cache_get(cache, "assets/mainplayer2.png"), NULL, &mainplayer2_location);
+                        break;
+                    case 4:
+                        SDL_RenderCopy(square_renderer, texture_cache_get(cache, "assets/platformer_instructions.png"), NULL, &popup_location);
+                        break;
+                    case 6:
+                        SDL_RenderCopy(square_renderer, texture_cache_get(cache, "assets/winner_screen.png"), NULL, &popup_location);
+                        SDL_RenderCopy(square_renderer, texture_cache_get(cache, "assets/mainplayer1.png"), NULL, &mainplayer1_location);
+                        SDL_RenderCopy(square_renderer, texture_cache_get(cache, "assets/mainplayer2.png"), NULL, &mainplayer2_location);
+                        break;
+
+                }
 
+                layer_cache_end(state->hub_layer);
             }
+            layer_cache_draw(state->hub_layer);
 
-            sdl_show();
+            perf_overlay_draw(scene);
+            render_batch_present();
             sdl_on_key(on_key_square);
             break;
         case 1:
@@ -448,6 +574,13 @@ void emscripten_main(state_t *state) {
                 if (state->player1.score + state->player2.score >= 30) {
                     state->curr_popup = 4;
                 }
+
+                // The result is read; release the whole session. Keys go
+                // back to the hub first so no event reaches the freed game.
+                sdl_on_key(on_key_square);
+                tanks_free(state->tanks_state);
+                state->tanks_state = NULL;
+                layer_cache_invalidate(state->hub_layer);
             }
             break;
         case 2:
@@ -469,11 +602,18 @@ void emscripten_main(state_t *state) {
                 }
 
                 state->curr_popup = 6;
+
+                sdl_on_key(on_key_square);
+                platformer_free(state->platformer_state);
+                state->platformer_state = NULL;
+                layer_cache_invalidate(state->hub_layer);
             }
             break;
     }
 }
 
 void emscripten_free(state_t *state) {
+    player_templates_free(state->player_templates);
+    layer_cache_free(state->hub_layer);
 
 }
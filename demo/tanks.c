@@ -8,6 +8,22 @@
 #include "sdl_wrapper.h"
 #include "state.h"
 #include "vector.h"
+#include "texture_cache.h"
+#include "render_batch.h"
+#include "slot_map.h"
+#include "broadphase.h"
+#include "command_buffer.h"
+#include "force_batch.h"
+#include "fixed_step.h"
+#include "arena.h"
+#include "frame_alloc.h"
+#include "layer_cache.h"
+#include "camera.h"
+#include "sprite_index.h"
+#include "profile.h"
+#include "perf_overlay.h"
+#include "jobs.h"
+#include "tank_atlas.h"
 #include <assert.h>
 #include <math.h>
 #include <stdio.h>
@@ -30,6 +46,11 @@ const vector_t CENTER_TANKS = (vector_t){.x = 500, .y = 250};
 #define R (sqrt(G * M / g_const))
 #define INIT_VEL 70
 const double ELASTICITY = 1;
+// Bullets are simulated at 120 Hz whatever the frame rate
+const double TANKS_STEP_DT = 1.0 / 120.0;
+const size_t TANKS_MAX_STEPS = 8;
+// Chunk size of the arena a session's state, bullets and craters live in
+const size_t TANKS_ARENA_CHUNK = 16 * 1024;
 
 // Sound
 Mix_Chunk *bullet_shot_wav = NULL;
@@ -96,7 +117,7 @@ typedef struct bullet {
     size_t player_num;
     SDL_Texture *image;
     SDL_Rect location;
-    body_t *body;
+    body_handle_t body;
 } bullet_t;
 
 // Structure for crater
@@ -131,6 +152,24 @@ typedef struct tanks_state {
     bool game_over;
     size_t counter;
     size_t winner;
+    texture_handle_t *landscape_texture;
+    texture_handle_t *atlas_texture;
+    slot_map_t *bodies;
+    body_handle_t gravity_body;
+    broadphase_t *broadphase;
+    fixed_step_t *stepper;
+    arena_t *arena;
+    // Background, landscape, craters and boulders, redrawn when they change
+    layer_cache_t *ground_layer;
+    // Craters and boulders by position, to draw only the visible ones
+    sprite_index_t *crater_index;
+    sprite_index_t *boulder_index;
+    command_buffer_t *commands;
+    // Gravity on every bullet, evaluated in one loop
+    force_batch_t *forces;
+    // Shots requested by key presses, fired at the start of the next step
+    // so the stepper never sees a bullet created after a tick
+    bool pending_shots[2];
 } tanks_state_t;
 
 // Structure for camera
@@ -177,25 +216,31 @@ list_t *make_rect(SDL_Rect rect) {
     return vertices;
 }
 
+// Tanks have infinite mass, so the bounce would only move the bullet.
+// aux is the game's command buffer; the bullet goes at the sync point.
+void bullet_hit_tank(body_t *tank, body_t *bullet, vector_t axis, void *aux) {
+    command_buffer_remove_body(aux, bullet);
+}
+
 void shoot_bullet(tanks_state_t *state, size_t player_num, scene_t *scene) {
+    frame_allow_malloc();
+
     // Make new bullet
-    bullet_t *new_bullet = malloc(sizeof(bullet_t));
-    new_bullet->image = IMG_LoadTexture(tanks_renderer, "assets/bullet.png");
+    bullet_t *new_bullet = arena_alloc(state->arena, sizeof(bullet_t));
+    new_bullet->image = texture_handle_get(state->atlas_texture);
 
     // Variables for width and height of image
-    size_t w = 0;
-    size_t h = 0;
+    size_t w = TANK_ATLAS_BULLET.w;
+    size_t h = TANK_ATLAS_BULLET.h;
 
     // Initialize bullets location
     if (player_num == 1) {
-        SDL_QueryTexture(new_bullet->image, NULL, NULL, &w, &h);
         if (state->player1.left) {
             new_bullet->location.x = state->player1.location.x; new_bullet->location.y = state->player1.location.y; new_bullet->location.w = BULLET_IMG_WIDTH; new_bullet->location.h = h * BULLET_IMG_WIDTH / w; 
         } else {
             new_bullet->location.x = state->player1.location.x + state->player1.location.w; new_bullet->location.y = state->player1.location.y; new_bullet->location.w = BULLET_IMG_WIDTH; new_bullet->location.h = h * BULLET_IMG_WIDTH / w; 
         }
     } else {
-        SDL_QueryTexture(new_bullet->image, NULL, NULL, &w, &h);
         if (state->player2.left) {
             new_bullet->location.x = state->player2.location.x; new_bullet->location.y = state->player2.location.y; new_bullet->location.w = BULLET_IMG_WIDTH; new_bullet->location.h = h * BULLET_IMG_WIDTH / w; 
         } else {
@@ -206,18 +251,19 @@ void shoot_bullet(tanks_state_t *state, size_t player_num, scene_t *scene) {
     // Initialize bullet's properties
     new_bullet->shape = 2;
     new_bullet->player_num = player_num;
-    new_bullet->body = body_init(make_rect(new_bullet->location), BULLET_MASS, BODY_COLOR);
-    scene_add_body(scene, new_bullet->body);
+    new_bullet->body = slot_map_body_init(state->bodies, make_rect(new_bullet->location), BULLET_MASS, BODY_COLOR);
+    body_t *bullet_body = slot_map_get(state->bodies, new_bullet->body);
+    scene_add_body(scene, bullet_body);
 
     // Add collision handler
     if (new_bullet->player_num == PLAYER_1) {
-        create_destructive_physics_collision(scene, ELASTICITY, state->player2.body, new_bullet->body);
+        broadphase_add_collision(state->broadphase, state->player2.body, bullet_body, bullet_hit_tank, state->commands, NULL);
     } else {
-        create_destructive_physics_collision(scene, ELASTICITY, state->player1.body, new_bullet->body);
+        broadphase_add_collision(state->broadphase, state->player1.body, bullet_body, bullet_hit_tank, state->commands, NULL);
     }
 
-    // Add gravity force creator
-    create_newtonian_gravity(scene, G, scene_get_body(scene, 0), new_bullet->body);
+    // Add gravity on the bullet
+    force_batch_add_gravity(state->forces, G, slot_map_get(state->bodies, state->gravity_body), bullet_body);
 
     // Set initial velocity
     vector_t init_velocity = {.x = -1.0 * INIT_VEL, .y = 0.0};
@@ -231,7 +277,7 @@ void shoot_bullet(tanks_state_t *state, size_t player_num, scene_t *scene) {
         init_velocity.x = init_velocity.x * cos(state->player2.angle);
         init_velocity.y = init_velocity.y * sin(state->player2.angle);
     }
-    body_set_velocity(new_bullet->body, init_velocity);
+    body_set_velocity(bullet_body, init_velocity);
 
     list_add(state->bullets, new_bullet);
 
@@ -239,33 +285,61 @@ void shoot_bullet(tanks_state_t *state, size_t player_num, scene_t *scene) {
 }
 
 void make_crater(tanks_state_t *state, size_t location_x, size_t location_y) {
+    frame_allow_malloc();
+
     // Make new crater
-    crater_t *new_crater = malloc(sizeof(crater_t));
-    new_crater->image = IMG_LoadTexture(tanks_renderer, "assets/crater.png");
+    crater_t *new_crater = arena_alloc(state->arena, sizeof(crater_t));
+    new_crater->image = texture_handle_get(state->atlas_texture);
 
     // Variables for width and height of image
-    size_t w = 0;
-    size_t h = 0;
-    SDL_QueryTexture(new_crater->image, NULL, NULL, &w, &h);
+    size_t w = TANK_ATLAS_CRATER.w;
+    size_t h = TANK_ATLAS_CRATER.h;
 
     new_crater->location.x = location_x; new_crater->location.y = location_y; new_crater->location.w = CRATER_IMG_WIDTH; new_crater->location.h = h * CRATER_IMG_WIDTH / w; 
 
     list_add(state->crater_list, new_crater);
+    sprite_index_add(state->crater_index, &new_crater->location, new_crater);
+    layer_cache_invalidate(state->ground_layer);
 }
 
 void make_boulder(tanks_state_t *state, size_t location_x, size_t location_y) {
     // Make new boulder
-    boulder_t *new_boulder = malloc(sizeof(boulder_t));
-    new_boulder->image = IMG_LoadTexture(tanks_renderer, "assets/boulder.png");
+    boulder_t *new_boulder = arena_alloc(state->arena, sizeof(boulder_t));
+    new_boulder->image = texture_handle_get(state->atlas_texture);
 
     // Variables for width and height of image
-    size_t w = 0;
-    size_t h = 0;
-    SDL_QueryTexture(new_boulder->image, NULL, NULL, &w, &h);
+    size_t w = TANK_ATLAS_BOULDER.w;
+    size_t h = TANK_ATLAS_BOULDER.h;
 
     new_boulder->location.x = location_x; new_boulder->location.y = location_y; new_boulder->location.w = BOULDER_IMG_WIDTH; new_boulder->location.h = h * BOULDER_IMG_WIDTH / w; 
 
     list_add(state->boulder_list, new_boulder);
+    sprite_index_add(state->boulder_index, &new_boulder->location, new_boulder);
+}
+
+// Releases the textures and sound effects. The session can end through
+// tanks_end() or straight from tanks_free() (the t key), so whichever runs
+// first does it and the other finds nothing left.
+static void tanks_release_media(tanks_state_t *state) {
+    // The shared cache keeps textures until its budget needs the room
+    texture_cache_t *cache = texture_cache_shared();
+    if (state->landscape_texture != NULL) {
+        texture_cache_release(cache, state->landscape_texture);
+        state->landscape_texture = NULL;
+    }
+    if (state->atlas_texture != NULL) {
+        texture_cache_release(cache, state->atlas_texture);
+        state->atlas_texture = NULL;
+    }
+
+    if (bullet_shot_wav != NULL) {
+        Mix_FreeChunk(bullet_shot_wav);
+        bullet_shot_wav = NULL;
+    }
+    if (player_won_wav != NULL) {
+        Mix_FreeChunk(player_won_wav);
+        player_won_wav = NULL;
+    }
 }
 
 void tanks_end(tanks_state_t *state) {
@@ -273,102 +347,44 @@ void tanks_end(tanks_state_t *state) {
     state->game_over = true;
     SDL_RenderClear(tanks_renderer);
 
-     // Free tank images
-    SDL_DestroyTexture(state->player1.image);
-
     while ( Mix_PlayingMusic() ) ;
-	Mix_FreeChunk(bullet_shot_wav);
-    Mix_FreeChunk(player_won_wav);
+    tanks_release_media(state);
 
     return;
 }
 
-char *curr_tank_image(size_t health, float angle, bool left, size_t player_num) {
-    char image_url[] = "assets/tanks/";
-
-    // Add health
-    if (health == HEALTH_MAX) {
-        strcat(image_url, "high");
-    } else if (health >= HEALTH_MAX - BULLET_DMG) {
-        strcat(image_url, "mid2");
-    } else if (health >= HEALTH_MAX - 2 * BULLET_DMG) {
-        strcat(image_url, "mid1");
-    } else if (health >= HEALTH_MAX - 3 * BULLET_DMG) {
-        strcat(image_url, "low");
-    } else {
-        strcat(image_url, "death");
-    }
-
-    if (health > 0) {
-        strcat(image_url, "Tank");
-
-        // Add angle
-        if (angle >= 2 * TANK_ANGLE_CHANGE) {
-            strcat(image_url, "High");
-        } else if (angle >= TANK_ANGLE_CHANGE) {
-            strcat(image_url, "Mid");
-        } else {
-            strcat(image_url, "Low");
-        }
-
-        // Add direction
-        if (left) {
-            strcat(image_url, "Left");
-        } else {
-            strcat(image_url, "Right");
+// Returns the atlas rectangle of a tank's current frame
+const SDL_Rect *curr_tank_sprite(size_t health, float angle, bool left, size_t player_num) {
+    // Each bullet drops the tank one health tier; the last tier is death
+    size_t health_tier = TANK_HEALTH_TIERS - 1;
+    if (health <= HEALTH_MAX) {
+        health_tier = (HEALTH_MAX - health + BULLET_DMG - 1) / BULLET_DMG;
+        if (health_tier > TANK_HEALTH_TIERS - 1) {
+            health_tier = TANK_HEALTH_TIERS - 1;
         }
     }
 
-    // Add player number
-    if (player_num == PLAYER_1) {
-        strcat(image_url, "1.png");
-    } else {
-        strcat(image_url, "2.png");
+    size_t angle_tier = 0;
+    if (angle >= 2 * TANK_ANGLE_CHANGE) {
+        angle_tier = 2;
+    } else if (angle >= TANK_ANGLE_CHANGE) {
+        angle_tier = 1;
     }
 
-    char *image_url_return = malloc(sizeof(char) * strlen(image_url));
-    image_url_return = image_url;
+    size_t facing = left ? 0 : 1;
+    size_t player = player_num == PLAYER_1 ? 0 : 1;
 
-    return image_url_return;
+    return &TANK_ATLAS_TANKS[health_tier][angle_tier][facing][player];
 }
 
+// Moves the view to camera_x; the world itself stays where it is
 void update_camera(tanks_state_t *state) {
-    // Adjust player locations
-    SDL_Rect adjusted_player1_location = state->player1.location;
-    adjusted_player1_location.x -= state->camera_x;
-
-    SDL_Rect adjusted_player2_location = state->player2.location;
-    adjusted_player2_location.x -= state->camera_x;
-
-    state->player1.location = adjusted_player1_location;  
-    state->player2.location = adjusted_player2_location; 
-
-    body_set_centroid(state->player1.body, (vector_t){.x = body_get_centroid(state->player1.body).x - state->camera_x, .y = body_get_centroid(state->player1.body).y});
-    body_set_centroid(state->player2.body, (vector_t){.x = body_get_centroid(state->player2.body).x - state->camera_x, .y = body_get_centroid(state->player2.body).y});
-
-    // Adjust bullet locations
-    for (size_t i = 0; i < list_size(state->bullets); i++) {
-        bullet_t *curr_bullet = list_get(state->bullets, i);
-        curr_bullet->location.x -= state->camera_x;
-        body_set_centroid(curr_bullet->body, (vector_t){.x = body_get_centroid(curr_bullet->body).x - state->camera_x, .y = body_get_centroid(curr_bullet->body).y});
-    }
-
-    // Adjust crater locations
-    for (size_t i = 0; i < list_size(state->crater_list); i++) {
-        crater_t *curr_crater = list_get(state->crater_list, i);
-        curr_crater->location.x -= state->camera_x;
-    }
-
-    // Adjust boulder locations
-    for (size_t i = 0; i < list_size(state->boulder_list); i++) {
-        boulder_t *curr_boulder = list_get(state->boulder_list, i);
-        curr_boulder->location.x -= state->camera_x;
-    }
+    camera_set_position((vector_t){.x = state->camera_x, .y = 0});
+    layer_cache_invalidate(state->ground_layer);
 }
 
 void on_key(char key, key_event_type_t type, double held_time, state_t *overall_state) {
   tanks_state_t *state = overall_state->game_state;
-  scene_t *scene = state->scene;
 
   if (type == KEY_PRESSED) {
     switch (key) {
@@ -386,7 +402,7 @@ void on_key(char key, key_event_type_t type, double held_time, state_t *overall_
             break;
         case SDLK_s:
             if (time_since_last_bullet_1 >= TIME_TO_FIRE_BULLET) {
-                shoot_bullet(state, PLAYER_1, scene);
+                state->pending_shots[PLAYER_1 - 1] = true;
                 time_since_last_bullet_1 = 0.0;
             }
             break;
@@ -411,7 +427,7 @@ void on_key(char key, key_event_type_t type, double held_time, state_t *overall_
             break;
         case DOWN_ARROW:
             if (time_since_last_bullet_2 >= TIME_TO_FIRE_BULLET) {
-                shoot_bullet(state, PLAYER_2, scene);
+                state->pending_shots[PLAYER_2 - 1] = true;
                 time_since_last_bullet_2 = 0.0;
             }
             break;
@@ -446,6 +462,17 @@ void on_key_blank(char key, key_event_type_t type, double held_time, state_t *ov
 
 
 // Initialize the game state
+// A sound effect loaded on a job worker
+typedef struct sound_load {
+    const char *path;
+    Mix_Chunk **chunk;
+} sound_load_t;
+
+static void load_sound(void *aux) {
+    sound_load_t *load = aux;
+    *load->chunk = Mix_LoadWAV(load->path);
+}
+
 tanks_state_t *tanks_init() {
     vector_t min = VEC_ZERO;
     vector_t max = WINDOW_TANKS;
@@ -453,47 +480,75 @@ tanks_state_t *tanks_init() {
     IMG_Init(IMG_INIT_PNG);
     Mix_OpenAudio(22050, MIX_DEFAULT_FORMAT, 2, 4096);
 
-    tanks_state_t *state = malloc(sizeof(tanks_state_t));
+    // Everything the session allocates itself goes in its arena
+    arena_t *arena = arena_init(TANKS_ARENA_CHUNK);
+    tanks_state_t *state = arena_alloc(arena, sizeof(tanks_state_t));
+    state->arena = arena;
     scene_t *scene = scene_init();
 
     tanks_renderer = sdl_return_renderer();
 
-    // Load sound effects
-    bullet_shot_wav = Mix_LoadWAV(BULLET_SHOT_WAV_PATH);
-    player_won_wav = Mix_LoadWAV(PLAYER_WON_WAV_PATH);
+    // Load sound effects on job workers while the rest is set up
+    sound_load_t sounds[] = {{BULLET_SHOT_WAV_PATH, &bullet_shot_wav},
+                             {PLAYER_WON_WAV_PATH, &player_won_wav}};
+    job_t sound_jobs[] = {{load_sound, &sounds[0]}, {load_sound, &sounds[1]}};
+    job_counter_t sounds_loaded = JOB_COUNTER_INIT;
+    jobs_run(sound_jobs, 2, &sounds_loaded);
+
+    // Bodies the game refers to later are tracked by handle
+    state->bodies = slot_map_init(10);
+
+    // Bullets only ever test against the tank they were fired at
+    state->broadphase = broadphase_init(scene, BROADPHASE_SWEEP_AND_PRUNE, 0);
+    state->commands = command_buffer_init(scene);
+    state->forces = force_batch_init(scene);
+    state->pending_shots[PLAYER_1 - 1] = false;
+    state->pending_shots[PLAYER_2 - 1] = false;
 
     // Create gravity body and add to scene
-    body_t *gravity_body = body_init(make_rect((SDL_Rect){.x = 0, .y = -R, .w = WINDOW_TANKS.x, .h = 1}), M, BODY_COLOR);
-    scene_add_body(scene, gravity_body);
+    state->gravity_body = slot_map_body_init(state->bodies, make_rect((SDL_Rect){.x = 0, .y = -R, .w = WINDOW_TANKS.x, .h = 1}), M, BODY_COLOR);
+    scene_add_body(scene, slot_map_get(state->bodies, state->gravity_body));
 
     // Initialize state's list of bullets
-    state->bullets = list_init(10, free);
+    state->bullets = list_init(10, arena_no_free);
 
     // Initialize state's list of craters
-    state->crater_list = list_init(10, free);
+    state->crater_list = list_init(10, arena_no_free);
 
     // Initialize state's list of bullets
-    state->boulder_list = list_init(10, free);
+    state->boulder_list = list_init(10, arena_no_free);
+    state->crater_index = sprite_index_init();
+    state->boulder_index = sprite_index_init();
 
     // Variables for width and height of image
     size_t w = 0;
     size_t h = 0;
 
+    // Acquire the landscape and the sprite atlas shared by every tank,
+    // bullet, crater and boulder
+    texture_cache_t *cache = texture_cache_shared();
+    const char *textures[] = {"assets/ground.png", TANK_ATLAS_PATH};
+    texture_cache_preload(cache, textures, 2);
+    state->landscape_texture = texture_cache_acquire(cache, "assets/ground.png");
+    state->atlas_texture = texture_cache_acquire(cache, TANK_ATLAS_PATH);
+
     // Initialize the landscape properties
-    state->landscape.image = IMG_LoadTexture(tanks_renderer, "assets/ground.png");
+    state->landscape.image = texture_handle_get(state->landscape_texture);
     SDL_QueryTexture(state->landscape.image, NULL, NULL, &w, &h);
     state->landscape.location.x = 0; state->landscape.location.y = LANDSCAPE_Y; state->landscape.location.w = w * WINDOW_TANKS.x / h; state->landscape.location.h = WINDOW_TANKS.x; 
 
-    // Load initial tank images for player 1 and player 2
-    state->player1.image = IMG_LoadTexture(tanks_renderer, "assets/tanks/highTankLowRight1.png");
-    state->player2.image = IMG_LoadTexture(tanks_renderer, "assets/tanks/highTankLowLeft2.png");
+    // Both tanks are drawn from the atlas
+    state->player1.image = texture_handle_get(state->atlas_texture);
+    state->player2.image = texture_handle_get(state->atlas_texture);
 
     // Initialize player 1's location
-    SDL_QueryTexture(state->player1.image, NULL, NULL, &w, &h);
+    w = curr_tank_sprite(HEALTH_MAX, 0.0, false, PLAYER_1)->w;
+    h = curr_tank_sprite(HEALTH_MAX, 0.0, false, PLAYER_1)->h;
     state->player1.location.x = 0; state->player1.location.y = CENTER_TANKS.y; state->player1.location.w = TANK_IMG_WIDTH; state->player1.location.h = h * TANK_IMG_WIDTH / w; 
 
     // Initialize player 2's location
-    SDL_QueryTexture(state->player2.image, NULL, NULL, &w, &h);
+    w = curr_tank_sprite(HEALTH_MAX, 0.0, true, PLAYER_2)->w;
+    h = curr_tank_sprite(HEALTH_MAX, 0.0, true, PLAYER_2)->h;
     state->player2.location.x = WINDOW_TANKS.x - 200; state->player2.location.y = CENTER_TANKS.y; state->player2.location.w = TANK_IMG_WIDTH; state->player2.location.h = h * TANK_IMG_WIDTH / w; 
 
     // Initialize player characters' properties
@@ -511,6 +566,8 @@ tanks_state_t *tanks_init() {
     state->player2.last_move = false;
     state->game_over = false;
     state->counter = 0;
+    state->camera_x = 0;
+    camera_reset();
     state->winner = 0;
 
     // Initialize player characters' bodies
@@ -525,39 +582,39 @@ tanks_state_t *tanks_init() {
     }
 
     state->scene = scene; 
+    state->stepper = fixed_step_init(TANKS_STEP_DT, TANKS_MAX_STEPS);
+    state->ground_layer = layer_cache_init(tanks_renderer);
     sdl_on_key(on_key);
+    jobs_wait(&sounds_loaded);
     return state;
 }
 
-// Main game loop
-void tanks_main(tanks_state_t *state, double game_dt) {
-    // Draw game objects on the screen
+// Advances the simulation by one fixed step
+static void tanks_step(tanks_state_t *state, double dt) {
+    PROFILE_ZONE("tanks_step");
     scene_t *scene = state->scene;
-    double dt = game_dt;
     time_since_last_bullet_1 = time_since_last_bullet_1 + dt;
     time_since_last_bullet_2 = time_since_last_bullet_2 + dt;
-    sdl_render_scene(scene);
-
-    // Draw background
-    SDL_SetRenderDrawColor(tanks_renderer, 173, 216, 230, 255);
-
-    // Clear the screen
-	SDL_RenderClear(tanks_renderer);
 
-    // Render landscape
-    SDL_RenderCopy(tanks_renderer, state->landscape.image, NULL, &state->landscape.location);
+    // Bullets are made after fixed_step_save() and before the tick, when no
+    // freed body's address can still be in the saved states
+    for (size_t player_num = PLAYER_1; player_num <= PLAYER_2; player_num++) {
+        if (state->pending_shots[player_num - 1]) {
+            shoot_bullet(state, player_num, scene);
+            state->pending_shots[player_num - 1] = false;
+        }
+    }
 
     scene_tick(scene, dt);
+    // Sync point: apply what the tick's handlers deferred
+    command_buffer_apply(state->commands);
 
-    // Loop through each bullet and render it
     for (size_t i = 0; i < list_size(state->bullets); i++) {
-        if (i >= list_size(state->bullets)) {
-            continue;
-        }
         bullet_t *curr_bullet = list_get(state->bullets, i);
+        body_t *bullet_body = slot_map_get(state->bodies, curr_bullet->body);
 
-        // Check if bullet has been removed
-        if (body_is_removed(curr_bullet->body)) {
+        // A stale handle means the bullet hit a tank and was removed
+        if (bullet_body == NULL) {
             // Take off health
             if (curr_bullet->player_num == 1) {
                 state->player2.health = state->player2.health - BULLET_DMG;
@@ -566,33 +623,84 @@ void tanks_main(tanks_state_t *state, double game_dt) {
             }
             list_remove(state->bullets, i);
             i--;
-        } else if (body_get_centroid(curr_bullet->body).y < GROUND_BORDER) {
-            // Add crater
+        } else if (body_get_centroid(bullet_body).y < GROUND_BORDER) {
+            // Add crater where the bullet was last drawn
             make_crater(state, curr_bullet->location.x, curr_bullet->location.y);
 
             // Destroy bullet if below window
-            scene_remove_body(scene, i + 3);
+            slot_map_remove(state->bodies, curr_bullet->body);
             list_remove(state->bullets, i);
-        } else {
-            // Update bullet's image position
-            curr_bullet->location.x = body_get_centroid(curr_bullet->body).x;
-            curr_bullet->location.y = WINDOW_TANKS.y - 1.0 * body_get_centroid(curr_bullet->body).y;
-            SDL_RenderCopy(tanks_renderer, curr_bullet->image, NULL, &curr_bullet->location);
+            i--;
         }
     }
+}
+
+static void add_crater_sprite(void *item, void *aux) {
+    crater_t *crater = item;
+    render_batch_add_sprite(aux, crater->image, &TANK_ATLAS_CRATER, &crater->location, 0);
+}
+
+static void add_boulder_sprite(void *item, void *aux) {
+    boulder_t *boulder = item;
+    render_batch_add_sprite(aux, boulder->image, &TANK_ATLAS_BOULDER, &boulder->location, 0);
+}
+
+// Main game loop
+void tanks_main(tanks_state_t *state, double game_dt) {
+    PROFILE_ZONE("tanks_main");
+    // Run the simulation in fixed steps, then draw between the last two
+    double dt = game_dt;
+    size_t steps = fixed_step_advance(state->stepper, dt);
+    for (size_t i = 0; i < steps; i++) {
+        fixed_step_save(state->stepper, state->scene);
+        tanks_step(state, fixed_step_get_dt(state->stepper));
+    }
+
+    // Sprites are batched and submitted together just before the frame is shown
+    render_batch_t *batch = render_batch_shared();
+
+    // The ground only changes with a new crater or a camera move
+    if (layer_cache_begin(state->ground_layer)) {
+        // Draw background
+        SDL_SetRenderDrawColor(tanks_renderer, 173, 216, 230, 255);
 
-    // Loop through each crater and render it
-    for (size_t i = 0; i < list_size(state->crater_list); i++) {
-        crater_t *curr_crater = list_get(state->crater_list, i);
-        SDL_RenderCopy(tanks_renderer, curr_crater->image, NULL, &curr_crater->location);
+        // Clear the screen
+        SDL_RenderClear(tanks_renderer);
+
+        // The landscape fills the window wherever the camera is, so it is
+        // drawn in screen space rather than batched with the world sprites
+        SDL_RenderCopy(tanks_renderer, state->landscape.image, NULL, &state->landscape.location);
+
+        // Render the craters and boulders in view
+        SDL_Rect view = render_batch_visible_rect(batch);
+        sprite_index_query(state->crater_index, &view, add_crater_sprite, batch);
+        sprite_index_query(state->boulder_index, &view, add_boulder_sprite, batch);
+
+        render_batch_flush(batch);
+        layer_cache_end(state->ground_layer);
     }
-    
+    layer_cache_draw(state->ground_layer);
+
+    // Loop through each bullet and render it where it is between steps
+    for (size_t i = 0; i < list_size(state->bullets); i++) {
+        bullet_t *curr_bullet = list_get(state->bullets, i);
+        body_t *bullet_body = slot_map_get(state->bodies, curr_bullet->body);
+        if (bullet_body == NULL) {
+            continue;
+        }
+        vector_t centroid = fixed_step_centroid(state->stepper, bullet_body);
+
+        // Update bullet's image position
+        curr_bullet->location.x = centroid.x;
+        curr_bullet->location.y = WINDOW_TANKS.y - 1.0 * centroid.y;
+        render_batch_add_sprite(batch, curr_bullet->image, &TANK_ATLAS_BULLET, &curr_bullet->location, 0);
+    }
+
     bool player_1_over_boulder = false;
     bool player_2_over_boulder = false;
-    // Loop through each boulder and render it
+    // Loop through each boulder and tilt the tanks driving over it
     for (size_t i = 0; i < list_size(state->boulder_list); i++) {
         boulder_t *curr_boulder = list_get(state->boulder_list, i);
-        SDL_RenderCopy(tanks_renderer, curr_boulder->image, NULL, &curr_boulder->location);
 
         // Check if players are going over boulder
         if (state->player1.location.x >= curr_boulder->location.x - BOULDER_IMG_OFFSET && state->player1.location.x <= curr_boulder->location.x - BOULDER_IMG_OFFSET + BOULDER_IMG_WIDTH / 2) {
@@ -656,15 +764,16 @@ void tanks_main(tanks_state_t *state, double game_dt) {
         }
     }
 
-    // Update player images
-    state->player1.image = IMG_LoadTexture(tanks_renderer, curr_tank_image(state->player1.health, state->player1.angle, state->player1.left, 1));
-    state->player2.image = IMG_LoadTexture(tanks_renderer, curr_tank_image(state->player2.health, state->player2.angle, state->player2.left, 2));
-
-    // Copy the texture to the rendering context
-	SDL_RenderCopyEx(tanks_renderer, state->player1.image, NULL, &state->player1.location, state->player1.img_angle, NULL, SDL_FLIP_NONE);
-    SDL_RenderCopyEx(tanks_renderer, state->player2.image, NULL, &state->player2.location, state->player2.img_angle, NULL, SDL_FLIP_NONE);
+    // Pick each tank's frame from the atlas and add it to the batch
+    const SDL_Rect *player1_sprite = curr_tank_sprite(state->player1.health, state->player1.angle, state->player1.left, PLAYER_1);
+    const SDL_Rect *player2_sprite = curr_tank_sprite(state->player2.health, state->player2.angle, state->player2.left, PLAYER_2);
+    render_batch_add_sprite(batch, state->player1.image, player1_sprite, &state->player1.location, state->player1.img_angle);
+    render_batch_add_sprite(batch, state->player2.image, player2_sprite, &state->player2.location, state->player2.img_angle);
 
-    sdl_show();
+    // The bullets and tanks go out in one geometry call over the ground
+    render_batch_flush(batch);
+    perf_overlay_draw(state->scene);
+    render_batch_present();
     state->counter = state->counter + 1;
 
     // Check if game is over
@@ -689,16 +798,30 @@ void tanks_main(tanks_state_t *state, double game_dt) {
     }
 }
 
-// Free memory and resources
+// Free memory and resources once the result has been read
 void tanks_free(tanks_state_t *state) {
-    // Free tank images
-    SDL_DestroyTexture(state->player1.image);
-    SDL_DestroyTexture(state->player2.image);
-
-    while ( Mix_PlayingMusic() ) ;
-	Mix_FreeChunk(bullet_shot_wav);
-    Mix_FreeChunk(player_won_wav);
-	
-	// Quit SDL_Mixer
+    arena_stats_t stats = arena_get_stats(state->arena);
+    SDL_Log("tanks arena: %zu bytes used at peak, %zu reserved in %zu chunks\n",
+            stats.peak_used, stats.peak_reserved, stats.chunks);
+
+    // The scene owns the bodies; the map only hears about them being freed
+    command_buffer_free(state->commands);
+    scene_free(state->scene);
+    slot_map_free(state->bodies);
+    fixed_step_free(state->stepper);
+    layer_cache_free(state->ground_layer);
+    // Leave the view as the hub expects it
+    camera_reset();
+    list_free(state->bullets);
+    list_free(state->crater_list);
+    list_free(state->boulder_list);
+    sprite_index_free(state->crater_index);
+    sprite_index_free(state->boulder_index);
+    // Unless tanks_end() already did, e.g. when t ended the game
+    tanks_release_media(state);
+    // Releases the state, bullets, craters and boulders in one go
+    arena_free(state->arena);
+
+	// Quit SDL_Mixer; the sound effects went with the rest of the media
 	Mix_CloseAudio();
 }
@@ -0,0 +1,74 @@
+#ifndef __ARENA_H__
+#define __ARENA_H__
+
+#include <stddef.h>
+
+/**
+ * A region allocator for memory that lives exactly as long as a session.
+ * Allocations bump a pointer through large chunks and are never freed one
+ * at a time; arena_free() releases all of them at once.
+ */
+typedef struct arena arena_t;
+
+/**
+ * Sizes of an arena. used counts bytes handed out, reserved counts bytes
+ * in chunks; the peaks are the largest values since arena_init() and show
+ * how much memory a whole session needed.
+ */
+typedef struct arena_stats {
+    size_t used;
+    size_t reserved;
+    size_t peak_used;
+    size_t peak_reserved;
+    size_t chunks;
+} arena_stats_t;
+
+/**
+ * Allocates an empty arena.
+ *
+ * @param chunk_size the size of each chunk; larger allocations get a chunk
+ *   of their own
+ * @return a pointer to the new arena
+ */
+arena_t *arena_init(size_t chunk_size);
+
+/**
+ * Frees an arena and every allocation made from it.
+ *
+ * @param arena a pointer to an arena returned from arena_init()
+ */
+void arena_free(arena_t *arena);
+
+/**
+ * Allocates uninitialized memory aligned for any type, like malloc().
+ *
+ * @param arena a pointer to an arena returned from arena_init()
+ * @param size the number of bytes to allocate
+ * @return a pointer to the memory, valid until the arena is freed or reset
+ */
+void *arena_alloc(arena_t *arena, size_t size);
+
+/**
+ * Releases every allocation but keeps the first chunk for reuse.
+ * The peaks are kept.
+ *
+ * @param arena a pointer to an arena returned from arena_init()
+ */
+void arena_reset(arena_t *arena);
+
+/**
+ * Returns the arena's current and peak sizes.
+ *
+ * @param arena a pointer to an arena returned from arena_init()
+ * @return a snapshot of the sizes
+ */
+arena_stats_t arena_get_stats(arena_t *arena);
+
+/**
+ * A free_func_t that does nothing, for lists holding arena allocations.
+ *
+ * @param value an arena allocation
+ */
+void arena_no_free(void *value);
+
+#endif
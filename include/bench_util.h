@@ -0,0 +1,63 @@
+#ifndef __BENCH_UTIL_H__
+#define __BENCH_UTIL_H__
+
+#include "list.h"
+#include "vector.h"
+#include <stddef.h>
+
+/**
+ * Runs a benchmark's operation ops times.
+ * Everything the function does is timed, so setup that should not count
+ * needs to happen before bench_run() and be passed through aux.
+ */
+typedef void (*bench_func_t)(void *aux, size_t ops);
+
+/**
+ * Starts a benchmark suite.
+ * Reads "--json FILE" from the command line; if given, bench_finish()
+ * writes the suite's results to FILE.
+ *
+ * @param argc the argument count passed to main()
+ * @param argv the arguments passed to main()
+ * @param suite the suite's name, e.g. "list"
+ */
+void bench_init(int argc, char **argv, const char *suite);
+
+/**
+ * Times a benchmark and prints its results.
+ * The batch size is grown until one sample takes about a millisecond,
+ * then a fixed number of samples is taken. Reports the mean and the
+ * 50th, 90th and 99th percentile nanoseconds per operation over samples,
+ * and the heap allocations and bytes per operation.
+ *
+ * @param name the benchmark's name, unique within the suite
+ * @param func the function that runs the operation
+ * @param aux an auxiliary value to pass to func
+ */
+void bench_run(const char *name, bench_func_t func, void *aux);
+
+/**
+ * Writes the JSON results if requested and frees the suite.
+ *
+ * @return the exit status for main()
+ */
+int bench_finish(void);
+
+/**
+ * Builds a regular polygon for shape benchmarks.
+ *
+ * @param sides the number of vertices
+ * @param radius the distance from the center to each vertex
+ * @param center the polygon's center
+ * @return a list of newly allocated vector_t vertices, counterclockwise
+ */
+list_t *bench_polygon(size_t sides, double radius, vector_t center);
+
+/**
+ * Keeps the optimizer from discarding a computed value.
+ *
+ * @param value the value to keep
+ */
+void bench_consume(double value);
+
+#endif
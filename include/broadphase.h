@@ -0,0 +1,112 @@
+#ifndef __BROADPHASE_H__
+#define __BROADPHASE_H__
+
+#include "body.h"
+#include "forces.h"
+#include "list.h"
+#include "scene.h"
+#include <stddef.h>
+
+/**
+ * Scene-level collision detection for many body pairs.
+ * Every tick the broadphase finds the tracked bodies whose bounding boxes
+ * overlap and runs the same separating axis test as find_collision() only on
+ * those. Shapes are kept in local space, shared between bodies with the same
+ * shape, and only moved into world space when a test needs them.
+ * Handlers fire when a pair starts colliding, like create_collision().
+ * Box updates and tests are split across threads with parallel_for();
+ * handlers still run on the ticking thread, in registration order.
+ *
+ * The broadphase runs as one force creator and drops removed bodies at the
+ * end of its tick, while the scene still holds them. A body removed later
+ * in the tick, by a force creator registered after the broadphase, is
+ * freed first; the next tick finds it gone from the scene and drops its
+ * pairs without reading it. Until then a new body can reuse its address
+ * and inherit those pairs, so bodies should be removed outside
+ * scene_tick(), by the broadphase's own handlers, or through a command
+ * buffer (see command_buffer.h). Tracked bodies must be in the scene.
+ */
+typedef struct broadphase broadphase_t;
+
+/**
+ * How candidate pairs are found.
+ * Sweep-and-prune sorts boxes along x and suits few, spread out bodies.
+ * The uniform grid buckets boxes into square cells and suits many bodies
+ * of similar size.
+ */
+typedef enum broadphase_kind {
+    BROADPHASE_SWEEP_AND_PRUNE,
+    BROADPHASE_UNIFORM_GRID
+} broadphase_kind_t;
+
+/**
+ * Counters for the last tick.
+ * candidates counts overlapping boxes; tests counts registered pairs among
+ * them that ran the separating axis test; reused counts pairs whose result
+ * was kept because neither body moved; contacts counts colliding pairs.
+ */
+typedef struct broadphase_stats {
+    size_t bodies;
+    size_t pairs;
+    size_t candidates;
+    size_t tests;
+    size_t reused;
+    size_t contacts;
+} broadphase_stats_t;
+
+/**
+ * Allocates a broadphase and adds it to a scene as a force creator.
+ * The scene frees it, along with every registered handler's aux.
+ *
+ * @param scene the scene whose ticks run the broadphase
+ * @param kind the backend to find candidate pairs with
+ * @param cell_size the side length of a grid cell; unused by sweep-and-prune
+ * @return a pointer to the new broadphase
+ */
+broadphase_t *broadphase_init(scene_t *scene, broadphase_kind_t kind, double cell_size);
+
+/**
+ * Registers a collision handler for a pair of bodies,
+ * with the same arguments and behavior as create_collision().
+ * The pair is dropped once either body is removed; each tracked body
+ * links to its own pairs, so that costs only the pairs it was in.
+ *
+ * @param broadphase a pointer to a broadphase returned from broadphase_init()
+ * @param body1 the first body
+ * @param body2 the second body
+ * @param handler a function to call when the bodies start colliding
+ * @param aux an auxiliary value to pass to the handler
+ * @param freer if non-NULL, a function to call on aux when the pair is dropped
+ */
+void broadphase_add_collision(broadphase_t *broadphase, body_t *body1, body_t *body2,
+                              collision_handler_t handler, void *aux, free_func_t freer);
+
+/**
+ * Drops every collision handler registered for two bodies, in either order,
+ * freeing their aux values at the start of the next tick.
+ * Does nothing if no handler is registered for them.
+ *
+ * @param broadphase a pointer to a broadphase returned from broadphase_init()
+ * @param body1 one body
+ * @param body2 the other body
+ */
+void broadphase_remove_collisions(broadphase_t *broadphase, body_t *body1, body_t *body2);
+
+/**
+ * Switches the backend used from the next tick on.
+ *
+ * @param broadphase a pointer to a broadphase returned from broadphase_init()
+ * @param kind the backend to find candidate pairs with
+ * @param cell_size the side length of a grid cell; unused by sweep-and-prune
+ */
+void broadphase_set_kind(broadphase_t *broadphase, broadphase_kind_t kind, double cell_size);
+
+/**
+ * Returns the counters for the last tick.
+ *
+ * @param broadphase a pointer to a broadphase returned from broadphase_init()
+ * @return a snapshot of the counters
+ */
+broadphase_stats_t broadphase_get_stats(broadphase_t *broadphase);
+
+#endif
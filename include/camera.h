@@ -0,0 +1,46 @@
+#ifndef __CAMERA_H__
+#define __CAMERA_H__
+
+#include "vector.h"
+
+/**
+ * The view the renderer draws the world through.
+ * Moving the camera changes only where things are drawn; bodies and
+ * sprite locations stay in world coordinates.
+ *
+ * position is the scene-space offset of the view: the point drawn at the
+ * window's center is the scene center plus position. zoom scales the
+ * view about the window's center, with 1.0 drawing the scene as is.
+ */
+typedef struct camera {
+    vector_t position;
+    double zoom;
+} camera_t;
+
+/**
+ * Returns the current camera.
+ *
+ * @return the camera's position and zoom
+ */
+camera_t camera_get(void);
+
+/**
+ * Moves the camera. Takes constant time however many things are drawn.
+ *
+ * @param position the new scene-space offset of the view
+ */
+void camera_set_position(vector_t position);
+
+/**
+ * Zooms the camera about the window's center.
+ *
+ * @param zoom the new zoom; must be positive
+ */
+void camera_set_zoom(double zoom);
+
+/**
+ * Puts the camera back at no offset and no zoom, as each game expects on start.
+ */
+void camera_reset(void);
+
+#endif
@@ -0,0 +1,117 @@
+#ifndef __COMMAND_BUFFER_H__
+#define __COMMAND_BUFFER_H__
+
+#include "body.h"
+#include "broadphase.h"
+#include "forces.h"
+#include "list.h"
+#include "scene.h"
+#include <stddef.h>
+
+/**
+ * A per-tick queue of structural changes to a scene: adding and removing
+ * bodies and force creators.
+ *
+ * Code that runs inside scene_tick(), such as collision handlers, records
+ * changes here instead of making them on the spot, so the bodies and
+ * forcers being iterated stay put for the whole tick. The game applies the
+ * buffer at one sync point after the tick's integration, in the order the
+ * commands were recorded, which makes the result independent of how the
+ * tick's phases were scheduled.
+ *
+ * Commands are recorded from the thread that runs scene_tick(). The buffer
+ * keeps its memory between ticks, so steady-state ticks do not allocate.
+ */
+typedef struct command_buffer command_buffer_t;
+
+/**
+ * Allocates an empty command buffer for a scene.
+ *
+ * @param scene the scene commands are applied to
+ * @return a pointer to the new buffer
+ */
+command_buffer_t *command_buffer_init(scene_t *scene);
+
+/**
+ * Frees a command buffer. Commands not yet applied are dropped, freeing
+ * the bodies they would have added and their forcers' aux values.
+ *
+ * @param buffer a pointer to a buffer returned from command_buffer_init()
+ */
+void command_buffer_free(command_buffer_t *buffer);
+
+/**
+ * Records adding a body to the scene. The scene owns it once applied.
+ *
+ * @param buffer a pointer to a buffer returned from command_buffer_init()
+ * @param body the body to add
+ */
+void command_buffer_add_body(command_buffer_t *buffer, body_t *body);
+
+/**
+ * Records removing a body, as body_remove() would. The scene frees the
+ * body, and the forcers acting on it, at the end of the next tick.
+ *
+ * @param buffer a pointer to a buffer returned from command_buffer_init()
+ * @param body the body to remove
+ */
+void command_buffer_remove_body(command_buffer_t *buffer, body_t *body);
+
+/**
+ * Records registering a force creator, with the same arguments as
+ * scene_add_bodies_force_creator().
+ *
+ * @param buffer a pointer to a buffer returned from command_buffer_init()
+ * @param forcer the force creator
+ * @param aux an auxiliary value to pass to forcer
+ * @param bodies the bodies forcer acts on, or NULL for a scene-wide forcer
+ * @param freer if non-NULL, a function to call on aux when the forcer is freed
+ */
+void command_buffer_add_force_creator(command_buffer_t *buffer, force_creator_t forcer,
+                                      void *aux, list_t *bodies, free_func_t freer);
+
+/**
+ * Records registering a collision handler with a broadphase,
+ * with the same arguments as broadphase_add_collision().
+ *
+ * @param buffer a pointer to a buffer returned from command_buffer_init()
+ * @param broadphase the broadphase to register with
+ * @param body1 the first body
+ * @param body2 the second body
+ * @param handler a function to call when the bodies start colliding
+ * @param aux an auxiliary value to pass to the handler
+ * @param freer if non-NULL, a function to call on aux when the pair is dropped
+ */
+void command_buffer_add_collision(command_buffer_t *buffer, broadphase_t *broadphase,
+                                  body_t *body1, body_t *body2, collision_handler_t handler,
+                                  void *aux, free_func_t freer);
+
+/**
+ * Records dropping every collision handler registered for two bodies,
+ * as broadphase_remove_collisions() would.
+ *
+ * @param buffer a pointer to a buffer returned from command_buffer_init()
+ * @param broadphase the broadphase the handlers are registered with
+ * @param body1 one body
+ * @param body2 the other body
+ */
+void command_buffer_remove_collisions(command_buffer_t *buffer, broadphase_t *broadphase,
+                                      body_t *body1, body_t *body2);
+
+/**
+ * Applies every recorded command in order and empties the buffer.
+ * Call at the sync point after scene_tick(), never from inside it.
+ *
+ * @param buffer a pointer to a buffer returned from command_buffer_init()
+ */
+void command_buffer_apply(command_buffer_t *buffer);
+
+/**
+ * Returns the number of commands waiting to be applied.
+ *
+ * @param buffer a pointer to a buffer returned from command_buffer_init()
+ * @return the number of recorded commands
+ */
+size_t command_buffer_size(command_buffer_t *buffer);
+
+#endif
@@ -0,0 +1,106 @@
+#ifndef __FIXED_STEP_H__
+#define __FIXED_STEP_H__
+
+#include "body.h"
+#include "render_batch.h"
+#include "scene.h"
+#include "vector.h"
+#include <stddef.h>
+
+/**
+ * Runs a game's simulation at a fixed tick rate, independent of frame rate.
+ * Each frame's time goes into an accumulator, which is drained in whole
+ * steps; time left over is drawn by interpolating between the body states
+ * before and after the last step.
+ *
+ * Typical frame:
+ *     size_t steps = fixed_step_advance(stepper, frame_dt);
+ *     for (size_t i = 0; i < steps; i++) {
+ *         fixed_step_save(stepper, scene);
+ *         ... scene_tick(scene, fixed_step_get_dt(stepper)) and game logic ...
+ *     }
+ *     fixed_step_add_scene(stepper, batch, scene);
+ *
+ * Bodies are matched to saved states by address. Each body's shape is
+ * copied the first time it is drawn and kept until a save finds the body
+ * gone from the scene, so frames draw without calling malloc. A body
+ * created after scene_tick() in the last step can reuse the address of a
+ * body that tick freed and be drawn from its old state and shape, so
+ * create bodies before ticking.
+ */
+typedef struct fixed_step fixed_step_t;
+
+/**
+ * Allocates a fixed stepper with an empty accumulator.
+ *
+ * @param dt the simulated time per step
+ * @param max_steps the most steps to run in one frame; time beyond that
+ *   is dropped, so a slow frame slows the game down instead of making the
+ *   next frame slower still
+ * @return a pointer to the new stepper
+ */
+fixed_step_t *fixed_step_init(double dt, size_t max_steps);
+
+/**
+ * Frees a stepper.
+ *
+ * @param stepper a pointer to a stepper returned from fixed_step_init()
+ */
+void fixed_step_free(fixed_step_t *stepper);
+
+/**
+ * Adds a frame's elapsed time and takes whole steps out of it.
+ *
+ * @param stepper a pointer to a stepper returned from fixed_step_init()
+ * @param frame_dt the real time since the last frame
+ * @return the number of steps to run this frame
+ */
+size_t fixed_step_advance(fixed_step_t *stepper, double frame_dt);
+
+/**
+ * Returns the simulated time per step.
+ *
+ * @param stepper a pointer to a stepper returned from fixed_step_init()
+ * @return the dt passed to fixed_step_init()
+ */
+double fixed_step_get_dt(fixed_step_t *stepper);
+
+/**
+ * Returns how far the frame is between the last two steps.
+ *
+ * @param stepper a pointer to a stepper returned from fixed_step_init()
+ * @return the leftover time as a fraction of a step, in [0, 1)
+ */
+double fixed_step_get_alpha(fixed_step_t *stepper);
+
+/**
+ * Records every body's centroid and rotation as the state before a step.
+ * Call it at the start of each step.
+ *
+ * @param stepper a pointer to a stepper returned from fixed_step_init()
+ * @param scene the scene about to be ticked
+ */
+void fixed_step_save(fixed_step_t *stepper, scene_t *scene);
+
+/**
+ * Returns where a body should be drawn this frame.
+ *
+ * @param stepper a pointer to a stepper returned from fixed_step_init()
+ * @param body a body in the stepped scene
+ * @return the centroid interpolated between the saved and current states,
+ *   or the current centroid if the body was created since the last save
+ */
+vector_t fixed_step_centroid(fixed_step_t *stepper, body_t *body);
+
+/**
+ * Adds every body in a scene that has not been removed to a render batch,
+ * each moved to its interpolated centroid and rotation.
+ * Replaces render_batch_add_scene() for stepped scenes.
+ *
+ * @param stepper a pointer to a stepper returned from fixed_step_init()
+ * @param batch the batch to add the bodies to
+ * @param scene the stepped scene
+ */
+void fixed_step_add_scene(fixed_step_t *stepper, render_batch_t *batch, scene_t *scene);
+
+#endif
@@ -0,0 +1,83 @@
+#ifndef __FORCE_BATCH_H__
+#define __FORCE_BATCH_H__
+
+#include "body.h"
+#include "scene.h"
+#include <stddef.h>
+
+/**
+ * The built-in forces of forces.c, evaluated in bulk.
+ * Instead of one force creator per body or pair, terms of each type are
+ * kept in packed arrays of constants and body indices. Every tick the
+ * batch reads each body's state once, runs one tight loop per type
+ * (split across threads with parallel_for()), and adds a single summed
+ * force to each body. Sums are taken in registration order whatever the
+ * thread count, so ticks are deterministic.
+ *
+ * Custom force creators keep going through scene_add_force_creator().
+ *
+ * The batch runs as one force creator. Terms acting on a body removed
+ * before it runs are dropped at the end of its tick, before the scene
+ * frees the body. Bodies removed by force creators registered after it
+ * follow the same rule as in the broadphase (see broadphase.h). Bodies
+ * must be in the scene.
+ */
+typedef struct force_batch force_batch_t;
+
+/**
+ * Counts for the last tick.
+ */
+typedef struct force_batch_stats {
+    size_t bodies;
+    size_t gravity;
+    size_t springs;
+    size_t drag;
+} force_batch_stats_t;
+
+/**
+ * Allocates an empty batch and adds it to a scene as a force creator.
+ * The scene frees it.
+ *
+ * @param scene the scene whose ticks apply the forces
+ * @return a pointer to the new batch
+ */
+force_batch_t *force_batch_init(scene_t *scene);
+
+/**
+ * Adds Newtonian gravity between two bodies, like create_newtonian_gravity().
+ *
+ * @param batch a pointer to a batch returned from force_batch_init()
+ * @param G the gravitational proportionality constant
+ * @param body1 the first body
+ * @param body2 the second body
+ */
+void force_batch_add_gravity(force_batch_t *batch, double G, body_t *body1, body_t *body2);
+
+/**
+ * Adds a Hooke's law spring between two bodies, like create_spring().
+ *
+ * @param batch a pointer to a batch returned from force_batch_init()
+ * @param k the spring constant
+ * @param body1 the first body
+ * @param body2 the second body
+ */
+void force_batch_add_spring(force_batch_t *batch, double k, body_t *body1, body_t *body2);
+
+/**
+ * Adds drag proportional to a body's velocity, like create_drag().
+ *
+ * @param batch a pointer to a batch returned from force_batch_init()
+ * @param gamma the drag constant
+ * @param body the body to slow down
+ */
+void force_batch_add_drag(force_batch_t *batch, double gamma, body_t *body);
+
+/**
+ * Returns the counts for the last tick.
+ *
+ * @param batch a pointer to a batch returned from force_batch_init()
+ * @return a snapshot of the counts
+ */
+force_batch_stats_t force_batch_get_stats(force_batch_t *batch);
+
+#endif
@@ -0,0 +1,82 @@
+#ifndef __FRAME_ALLOC_H__
+#define __FRAME_ALLOC_H__
+
+#include "arena.h"
+#include <stddef.h>
+
+/**
+ * Scratch memory that lives for one frame, plus a debug check that frames
+ * in steady state do not call malloc.
+ *
+ * frame_begin() is called at the top of every frame. It releases the
+ * previous frame's scratch allocations in O(1); after the first few frames
+ * the scratch arena is one chunk and resetting it never allocates.
+ * Each thread has its own scratch arena.
+ *
+ * Building with -DFRAME_ALLOC_CHECK and linking with
+ * -Wl,--wrap=malloc,--wrap=calloc counts the malloc and calloc calls made
+ * by the game and library objects. frame_begin() then asserts that the
+ * frame before it made none, unless it called frame_allow_malloc().
+ * realloc is not counted: it only grows persistent buffers, which settles
+ * after the first frames.
+ */
+
+/**
+ * Counters for the last complete frame.
+ * mallocs and untracked are always 0 unless built with FRAME_ALLOC_CHECK.
+ */
+typedef struct frame_stats {
+    size_t mallocs;
+    size_t untracked;
+    size_t scratch_bytes;
+} frame_stats_t;
+
+/**
+ * Ends the previous frame and starts a new one, releasing every
+ * frame_alloc() allocation. With FRAME_ALLOC_CHECK, asserts that the
+ * previous frame made no tracked malloc calls unless it allowed them.
+ */
+void frame_begin(void);
+
+/**
+ * Allocates scratch memory aligned for any type.
+ *
+ * @param size the number of bytes to allocate
+ * @return a pointer to the memory, valid until the next frame_begin()
+ */
+void *frame_alloc(size_t size);
+
+/**
+ * Returns the calling thread's scratch arena, for APIs that take an arena.
+ * Allocations from it are valid until the next frame_begin().
+ *
+ * @return the scratch arena
+ */
+arena_t *frame_arena(void);
+
+/**
+ * Marks the current frame as one that is expected to call malloc,
+ * such as a frame that spawns bodies or starts a game.
+ */
+void frame_allow_malloc(void);
+
+/**
+ * Stops counting malloc calls against the frame until frame_untracked_end().
+ * Wraps calls into code outside this tree that copies on every call, so
+ * the check still covers everything else. Calls nest.
+ */
+void frame_untracked_begin(void);
+
+/**
+ * Resumes counting malloc calls against the frame.
+ */
+void frame_untracked_end(void);
+
+/**
+ * Returns the counters for the last complete frame.
+ *
+ * @return a snapshot of the counters
+ */
+frame_stats_t frame_get_stats(void);
+
+#endif
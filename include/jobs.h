@@ -0,0 +1,115 @@
+#ifndef __JOBS_H__
+#define __JOBS_H__
+
+#include <SDL2/SDL.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * A work-stealing job scheduler shared by the whole engine.
+ *
+ * Each worker thread, and the main thread, owns a deque of jobs. A thread
+ * pushes and pops its own jobs at the back, newest first; idle workers
+ * steal the oldest job from the front of another thread's deque.
+ * Subsystems submit jobs here rather than starting threads of their own.
+ *
+ * Completion is tracked with counters: jobs_run() adds the number of jobs
+ * to a counter and each job takes one off when it finishes. Jobs can also
+ * wait for a counter to reach zero before they start, and jobs_wait() runs
+ * other jobs while it waits, so waiting threads never sit idle.
+ *
+ * Workers start with the first job. Without pthreads (plain WASM builds)
+ * there are none and jobs run on the thread that waits for them.
+ */
+
+/**
+ * The most worker threads the scheduler starts.
+ */
+#define JOBS_MAX_WORKERS 16
+
+/**
+ * A function to run as a job.
+ *
+ * @param aux the job's auxiliary value
+ */
+typedef void (*job_func_t)(void *aux);
+
+/**
+ * A job to submit: a function and the value to call it with.
+ */
+typedef struct job {
+    job_func_t func;
+    void *aux;
+} job_t;
+
+typedef struct job_waiter job_waiter_t;
+
+/**
+ * Counts unfinished jobs. Zero-initialize one (JOB_COUNTER_INIT) before
+ * use; it must stay alive until it reaches zero.
+ */
+typedef struct job_counter {
+    SDL_atomic_t value;
+    // Jobs to submit once the value reaches zero
+    job_waiter_t *waiters;
+    SDL_SpinLock lock;
+} job_counter_t;
+
+#define JOB_COUNTER_INIT {.value = {0}, .waiters = NULL, .lock = 0}
+
+/**
+ * Sets how many worker threads run jobs besides the main thread.
+ * Must be called from the main thread while no jobs are running.
+ * The default is one per CPU besides the main thread, up to JOBS_MAX_WORKERS,
+ * or up to the pthread pool size in WASM builds with pthreads.
+ *
+ * @param workers the number of worker threads
+ */
+void jobs_set_workers(size_t workers);
+
+/**
+ * Returns how many worker threads run jobs besides the main thread.
+ *
+ * @return the worker count
+ */
+size_t jobs_get_workers(void);
+
+/**
+ * Submits jobs to the calling thread's deque.
+ *
+ * @param jobs the jobs to run; the array is copied
+ * @param count the number of jobs
+ * @param counter if non-NULL, a counter to add count to;
+ *                each job takes one off when it finishes
+ */
+void jobs_run(const job_t *jobs, size_t count, job_counter_t *counter);
+
+/**
+ * Submits jobs that start only once another counter reaches zero.
+ * If it is zero already they are submitted straight away.
+ *
+ * @param dependency the counter to wait for
+ * @param jobs the jobs to run; the array is copied
+ * @param count the number of jobs
+ * @param counter if non-NULL, a counter to add count to
+ */
+void jobs_run_after(job_counter_t *dependency, const job_t *jobs, size_t count,
+                    job_counter_t *counter);
+
+/**
+ * Returns whether every job counted by a counter has finished.
+ *
+ * @param counter the counter
+ * @return true if the counter is zero
+ */
+bool job_counter_done(job_counter_t *counter);
+
+/**
+ * Runs queued jobs until a counter reaches zero, sleeping only when there
+ * is nothing left to run or steal. Can be called from inside a job.
+ *
+ * @param counter the counter to wait for
+ */
+void jobs_wait(job_counter_t *counter);
+
+#endif
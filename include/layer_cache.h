@@ -0,0 +1,91 @@
+#ifndef __LAYER_CACHE_H__
+#define __LAYER_CACHE_H__
+
+#include <SDL2/SDL.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * Static content rendered once into a target texture the size of the
+ * window and then shown with a single copy per frame.
+ * The owner invalidates the layer whenever what it shows changes.
+ *
+ * Usage:
+ *     if (layer_cache_begin(layer)) {
+ *         ...draw the static content...
+ *         layer_cache_end(layer);
+ *     }
+ *     layer_cache_draw(layer);
+ *
+ * On renderers without target textures begin() always returns true and
+ * the content is drawn straight to the window, so callers need no fallback.
+ */
+typedef struct layer_cache layer_cache_t;
+
+/**
+ * Counters for a layer.
+ * renders counts redraws into the texture, blits counts copies to the window.
+ */
+typedef struct layer_cache_stats {
+    size_t renders;
+    size_t blits;
+} layer_cache_stats_t;
+
+/**
+ * Allocates an invalid layer; its texture is created on first use.
+ *
+ * @param renderer the renderer the layer draws with
+ * @return a pointer to the new layer
+ */
+layer_cache_t *layer_cache_init(SDL_Renderer *renderer);
+
+/**
+ * Destroys the layer's texture and frees the layer.
+ *
+ * @param layer a pointer to a layer returned from layer_cache_init()
+ */
+void layer_cache_free(layer_cache_t *layer);
+
+/**
+ * Marks the layer's content as stale so the next begin() redraws it.
+ *
+ * @param layer a pointer to a layer returned from layer_cache_init()
+ */
+void layer_cache_invalidate(layer_cache_t *layer);
+
+/**
+ * Starts redrawing the layer if it is invalid.
+ * When it returns true, rendering goes to the layer's texture, cleared to
+ * transparent, until layer_cache_end(); when it returns false the cached
+ * content is still good and nothing needs drawing.
+ * The texture is recreated if the window's output size changed.
+ *
+ * @param layer a pointer to a layer returned from layer_cache_init()
+ * @return whether the caller should draw the layer's content
+ */
+bool layer_cache_begin(layer_cache_t *layer);
+
+/**
+ * Finishes a redraw started by layer_cache_begin() and restores the
+ * previous render target.
+ *
+ * @param layer a pointer to a layer returned from layer_cache_init()
+ */
+void layer_cache_end(layer_cache_t *layer);
+
+/**
+ * Copies the layer over the whole window.
+ *
+ * @param layer a pointer to a layer returned from layer_cache_init()
+ */
+void layer_cache_draw(layer_cache_t *layer);
+
+/**
+ * Returns the layer's counters.
+ *
+ * @param layer a pointer to a layer returned from layer_cache_init()
+ * @return a snapshot of the counters
+ */
+layer_cache_stats_t layer_cache_get_stats(layer_cache_t *layer);
+
+#endif
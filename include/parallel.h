@@ -0,0 +1,75 @@
+#ifndef __PARALLEL_H__
+#define __PARALLEL_H__
+
+#include <stddef.h>
+
+/**
+ * Fork-join loops for splitting the simulation's work across threads.
+ *
+ * parallel_for() cuts a loop into chunks of a fixed size and submits jobs
+ * that claim them to the job scheduler (see jobs.h); the calling thread
+ * runs chunks too and helps with other jobs until all are done.
+ * Chunk boundaries depend only on the loop's size and grain, never on the
+ * thread count, so a caller that keeps one result buffer per chunk and
+ * reduces them in chunk order gets bit-identical results with any number
+ * of threads.
+ *
+ * Loops are single-threaded by default, and always in WASM builds without
+ * pthreads. Loops may be started from inside a chunk or another job.
+ */
+
+/**
+ * Threads used until parallel_set_threads() is called, counting the caller.
+ */
+#define PARALLEL_DEFAULT_THREADS 1
+
+/**
+ * A loop body. Runs the iterations [start, end), which make up one chunk.
+ *
+ * @param aux the value passed to parallel_for()
+ * @param start the first iteration of the chunk
+ * @param end one past the last iteration of the chunk
+ * @param chunk the chunk's index, start / grain
+ */
+typedef void (*parallel_func_t)(void *aux, size_t start, size_t end, size_t chunk);
+
+/**
+ * Sets how many threads may run a loop's chunks, counting the thread that
+ * calls parallel_for(). Only as many threads as the job scheduler has
+ * workers, plus the caller, can actually take part.
+ *
+ * @param threads the thread count, or 0 for every job worker
+ */
+void parallel_set_threads(size_t threads);
+
+/**
+ * Returns how many threads run loops, counting the caller.
+ *
+ * @return the thread count, at least 1
+ */
+size_t parallel_get_threads(void);
+
+/**
+ * Returns how many chunks parallel_for() splits a loop into,
+ * for sizing per-chunk buffers.
+ *
+ * @param count the number of iterations
+ * @param grain the number of iterations per chunk
+ * @return the number of chunks
+ */
+size_t parallel_chunks(size_t count, size_t grain);
+
+/**
+ * Runs func over the iterations [0, count) in chunks of grain iterations
+ * and waits for every chunk. Chunks run in any order and on any thread, so
+ * they must only write memory no other chunk touches.
+ * Loops with a single chunk run inline.
+ *
+ * @param count the number of iterations
+ * @param grain the number of iterations per chunk, at least 1
+ * @param func the loop body
+ * @param aux an auxiliary value to pass to func
+ */
+void parallel_for(size_t count, size_t grain, parallel_func_t func, void *aux);
+
+#endif
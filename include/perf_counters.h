@@ -0,0 +1,67 @@
+#ifndef __PERF_COUNTERS_H__
+#define __PERF_COUNTERS_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * A registry of named counters that library modules update as they work
+ * and the performance overlay (see perf_overlay.h) reads once a frame.
+ *
+ * Modules register a counter once, keep the pointer and update it with
+ * plain stores, so counting costs no more than the work being counted.
+ */
+typedef struct perf_counter {
+    const char *name;
+    double value;
+    // Per-frame counters go back to 0 after every perf_counters_frame_end()
+    bool per_frame;
+} perf_counter_t;
+
+/**
+ * Returns the counter with a name, registering it on first use.
+ *
+ * @param name the counter's name as shown in the overlay; must outlive the program
+ * @param per_frame whether the counter sums one frame's work rather than
+ *                  holding a current value
+ * @return the counter, valid for the rest of the program
+ */
+perf_counter_t *perf_counter_register(const char *name, bool per_frame);
+
+/**
+ * Sets a counter, for values such as sizes that are not sums.
+ *
+ * @param counter a counter returned by perf_counter_register()
+ * @param value the new value
+ */
+void perf_counter_set(perf_counter_t *counter, double value);
+
+/**
+ * Adds to a counter.
+ *
+ * @param counter a counter returned by perf_counter_register()
+ * @param amount how much to add
+ */
+void perf_counter_add(perf_counter_t *counter, double amount);
+
+/**
+ * Returns the number of registered counters.
+ *
+ * @return the registry's size
+ */
+size_t perf_counters_size(void);
+
+/**
+ * Returns a counter by registration order.
+ *
+ * @param index the counter's index, less than perf_counters_size()
+ * @return the counter
+ */
+perf_counter_t *perf_counters_get(size_t index);
+
+/**
+ * Resets the per-frame counters once they have been read.
+ */
+void perf_counters_frame_end(void);
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef __PERF_OVERLAY_H__
+#define __PERF_OVERLAY_H__
+
+#include "scene.h"
+#include <stdbool.h>
+
+/**
+ * An on-screen panel with the frame time, a sparkline of recent frames
+ * with their p50 and p99, and every counter in the perf_counters registry.
+ * F3 shows and hides it in any game.
+ *
+ * Text is drawn with SDL_ttf from PERF_OVERLAY_FONT, falling back to common
+ * system fonts; without a font only the sparkline is shown.
+ * Lines are re-rendered at most a few times a second and only when they
+ * change, so an open overlay barely moves the numbers it shows.
+ */
+
+#define PERF_OVERLAY_FONT "assets/overlay.ttf"
+
+/**
+ * Records the frame's time and, if the overlay is shown, draws it over
+ * everything else. Call once per frame just before sdl_show().
+ * Resets the per-frame counters afterwards.
+ *
+ * @param scene the scene being shown, for the body count, or NULL
+ */
+void perf_overlay_draw(scene_t *scene);
+
+/**
+ * Shows or hides the overlay, as F3 does.
+ */
+void perf_overlay_toggle(void);
+
+/**
+ * Returns whether the overlay is shown.
+ *
+ * @return true if perf_overlay_draw() draws the panel
+ */
+bool perf_overlay_visible(void);
+
+#endif
@@ -5,6 +5,7 @@
 #include "list.h"
 #include "color.h"
 #include "scene.h"
+#include "broadphase.h"
 #include <SDL2/SDL.h>
 
 body_t *platform_init(list_t *shape, double mass, rgb_color_t color,
@@ -17,6 +18,6 @@ void platform_draw(SDL_Renderer *SDL_Renderer, body_t *platform);
 
 void platform_free(body_t *platform);
 
-void create_platform_for_body(scene_t *scene, body_t *platform, body_t *body);
+void create_platform_for_body(broadphase_t *broadphase, body_t *platform, body_t *body);
 
 #endif
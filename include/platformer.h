@@ -27,3 +27,5 @@ platformer_state_t *platformer_init();
 void platformer_main(platformer_state_t *state, double game_dt);
 
 void platformer_end(platformer_state_t *state);
+
+void platformer_free(platformer_state_t *state);
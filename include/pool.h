@@ -0,0 +1,70 @@
+#ifndef __POOL_H__
+#define __POOL_H__
+
+#include <stddef.h>
+
+/**
+ * A free-list allocator for many objects of one type, such as the aux
+ * structs behind force creators and collision handlers.
+ * Objects are carved out of chunks that are never moved or returned to
+ * malloc until the pool is freed, so pointers stay valid and a released
+ * object's memory is reused by the next allocation.
+ *
+ * Each pool can feed a counter in the perf_counters registry with how many
+ * objects its chunks hold; pools of the same name share it. Read next to
+ * a count of live objects it shows how full the pools are.
+ */
+typedef struct pool pool_t;
+
+/**
+ * Sizes of a pool, in objects.
+ */
+typedef struct pool_stats {
+    size_t used;
+    size_t capacity;
+    size_t chunks;
+} pool_stats_t;
+
+/**
+ * Allocates an empty pool.
+ *
+ * @param object_size the size of each object, e.g. sizeof(pair_t)
+ * @param chunk_objects how many objects each chunk holds
+ * @param name the name of the capacity counter shown in the performance
+ *             overlay, or NULL for none; must outlive the program
+ * @return a pointer to the new pool
+ */
+pool_t *pool_init(size_t object_size, size_t chunk_objects, const char *name);
+
+/**
+ * Frees a pool and every object in it, released or not.
+ *
+ * @param pool a pointer to a pool returned from pool_init()
+ */
+void pool_free(pool_t *pool);
+
+/**
+ * Allocates an uninitialized object aligned for any type.
+ *
+ * @param pool a pointer to a pool returned from pool_init()
+ * @return a pointer to the object, valid until it is released
+ */
+void *pool_alloc(pool_t *pool);
+
+/**
+ * Returns an object to the pool for reuse.
+ *
+ * @param pool the pool the object came from
+ * @param object a pointer returned from pool_alloc()
+ */
+void pool_release(pool_t *pool, void *object);
+
+/**
+ * Returns the pool's sizes.
+ *
+ * @param pool a pointer to a pool returned from pool_init()
+ * @return a snapshot of the sizes
+ */
+pool_stats_t pool_get_stats(pool_t *pool);
+
+#endif
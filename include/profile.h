@@ -0,0 +1,72 @@
+#ifndef __PROFILE_H__
+#define __PROFILE_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * Scoped timing zones, dumped as a Chrome trace-event file that loads in
+ * chrome://tracing or https://ui.perfetto.dev.
+ *
+ * PROFILE_ZONE("name") times from where it appears to the end of the
+ * enclosing block. Zones only exist when built with -DPROFILE ("make native
+ * PROFILE=1"); otherwise the macro compiles to nothing.
+ *
+ * Each thread records into its own ring buffer, so a long run keeps its most
+ * recent events. The trace is written when the program exits, to the path
+ * given to profile_set_output() or PROFILE_DEFAULT_OUTPUT, and whenever
+ * profile_dump() is called.
+ */
+
+#define PROFILE_DEFAULT_OUTPUT "out/trace.json"
+
+/**
+ * An open zone. Names must be string literals or otherwise outlive the trace.
+ */
+typedef struct profile_zone {
+    const char *name;
+    uint64_t start;
+} profile_zone_t;
+
+#ifdef PROFILE
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_ZONE(name)                                                                 \
+    profile_zone_t PROFILE_CONCAT(profile_zone_, __LINE__)                                 \
+        __attribute__((cleanup(profile_zone_end))) = profile_zone_begin(name)
+#else
+#define PROFILE_ZONE(name) do {} while (0)
+#endif
+
+/**
+ * Opens a zone. Use PROFILE_ZONE() rather than calling this directly.
+ *
+ * @param name the zone's name
+ * @return the open zone
+ */
+profile_zone_t profile_zone_begin(const char *name);
+
+/**
+ * Closes a zone and records it in the calling thread's ring buffer.
+ *
+ * @param zone the zone returned by profile_zone_begin()
+ */
+void profile_zone_end(profile_zone_t *zone);
+
+/**
+ * Sets where the trace is written at exit.
+ *
+ * @param path the file to write; it must outlive the program's run
+ */
+void profile_set_output(const char *path);
+
+/**
+ * Writes every thread's recorded zones as Chrome trace-event JSON.
+ * Recording continues afterwards.
+ *
+ * @param path the file to write
+ * @return whether the file was written
+ */
+bool profile_dump(const char *path);
+
+#endif
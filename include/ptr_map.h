@@ -0,0 +1,109 @@
+#ifndef __PTR_MAP_H__
+#define __PTR_MAP_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * A hash map from pointers, such as bodies, to indices into an owner's
+ * array. Entries are found by linear probing from a hash of the address.
+ * Removing an entry shifts later entries of its probe run back, so
+ * lookups never step over deleted slots. The table doubles to stay at
+ * most half full and never shrinks, so clearing and refilling it does not
+ * allocate.
+ */
+typedef struct ptr_map ptr_map_t;
+
+/**
+ * Allocates an empty map.
+ *
+ * @param initial_size how many entries to make room for
+ * @return a pointer to the new map
+ */
+ptr_map_t *ptr_map_init(size_t initial_size);
+
+/**
+ * Frees a map.
+ *
+ * @param map a pointer to a map returned from ptr_map_init()
+ */
+void ptr_map_free(ptr_map_t *map);
+
+/**
+ * Looks up a key.
+ *
+ * @param map a pointer to a map returned from ptr_map_init()
+ * @param key the pointer to find; must not be NULL
+ * @param value set to the key's value if it is found
+ * @return whether the key is in the map
+ */
+bool ptr_map_get(ptr_map_t *map, const void *key, size_t *value);
+
+/**
+ * Sets a key's value, adding the key if it is not in the map.
+ *
+ * @param map a pointer to a map returned from ptr_map_init()
+ * @param key the pointer to set; must not be NULL
+ * @param value the value to store
+ */
+void ptr_map_put(ptr_map_t *map, const void *key, size_t value);
+
+/**
+ * Removes a key if it is in the map.
+ *
+ * @param map a pointer to a map returned from ptr_map_init()
+ * @param key the pointer to remove
+ */
+void ptr_map_remove(ptr_map_t *map, const void *key);
+
+/**
+ * Removes every key, keeping the table.
+ *
+ * @param map a pointer to a map returned from ptr_map_init()
+ */
+void ptr_map_clear(ptr_map_t *map);
+
+/**
+ * Returns the number of keys in the map.
+ *
+ * @param map a pointer to a map returned from ptr_map_init()
+ * @return the number of keys
+ */
+size_t ptr_map_size(ptr_map_t *map);
+
+/**
+ * Scrambles a key so its low bits index a power-of-two table.
+ * Shared with tables keyed by something other than a pointer.
+ *
+ * @param key the key, e.g. an address or two packed indices
+ * @return the hash
+ */
+size_t ptr_map_hash(uint64_t key);
+
+/**
+ * Whether, when slot i of a linear-probing table is emptied, the entry
+ * at slot j further along the same run may move back into i. It may
+ * unless that would put it before home, the slot its hash lands on.
+ *
+ * @param i the emptied slot
+ * @param j the slot holding the entry
+ * @param home the entry's home slot
+ * @return whether the entry may move to slot i
+ */
+bool ptr_map_can_shift(size_t i, size_t j, size_t home);
+
+/**
+ * Makes room in a realloc'd array, doubling its capacity as often as
+ * needed. Arrays that only ever grow, such as scratch space reused every
+ * tick, stop reallocating once they fit their largest use.
+ *
+ * @param array the array, or NULL if it has no capacity yet
+ * @param capacity the array's capacity in elements; updated
+ * @param needed how many elements it must hold
+ * @param elem_size the size of each element
+ * @return the possibly moved array
+ */
+void *array_grow(void *array, size_t *capacity, size_t needed, size_t elem_size);
+
+#endif
@@ -0,0 +1,169 @@
+#ifndef __RENDER_BATCH_H__
+#define __RENDER_BATCH_H__
+
+#include "body.h"
+#include "color.h"
+#include "list.h"
+#include "scene.h"
+#include "vector.h"
+#include "vertex_array.h"
+#include <SDL2/SDL.h>
+#include <stddef.h>
+
+/**
+ * Collects polygons and sprites for one frame and submits them with as few
+ * SDL_RenderGeometry calls as possible.
+ * Consecutive draws that use the same texture (or no texture) share a call,
+ * so draw order is preserved.
+ * Anything entirely outside the camera's view is dropped when it is added.
+ * The view is taken from the camera at the first add after a flush.
+ */
+typedef struct render_batch render_batch_t;
+
+/**
+ * Counters for the last call to render_batch_flush().
+ * polygons and sprites were drawn; the culled ones were entirely outside
+ * the view and never reached the renderer.
+ * submit_time is in seconds and covers the transform and the SDL calls.
+ */
+typedef struct render_batch_stats {
+    size_t draw_calls;
+    size_t polygons;
+    size_t sprites;
+    size_t culled_polygons;
+    size_t culled_sprites;
+    size_t vertices;
+    size_t triangles;
+    double submit_time;
+} render_batch_stats_t;
+
+/**
+ * Allocates an empty batch.
+ *
+ * @param renderer the renderer the batch submits to
+ * @return a pointer to the new batch
+ */
+render_batch_t *render_batch_init(SDL_Renderer *renderer);
+
+/**
+ * Frees a batch and its buffers.
+ *
+ * @param batch a pointer to a batch returned from render_batch_init()
+ */
+void render_batch_free(render_batch_t *batch);
+
+/**
+ * Returns the batch shared by all the games, creating it on first use
+ * for the renderer returned by sdl_return_renderer().
+ *
+ * @return the shared batch
+ */
+render_batch_t *render_batch_shared(void);
+
+/**
+ * Adds a filled polygon given in scene coordinates.
+ * Convex polygons are fanned; concave ones are ear-clipped.
+ *
+ * @param batch a pointer to a batch returned from render_batch_init()
+ * @param points the polygon's vertices as a list of vector_t pointers
+ * @param color the fill color
+ */
+void render_batch_add_polygon(render_batch_t *batch, list_t *points, rgb_color_t color);
+
+/**
+ * Adds a filled polygon given in scene coordinates, like
+ * render_batch_add_polygon() but copying the points in one go.
+ *
+ * @param batch a pointer to a batch returned from render_batch_init()
+ * @param points the polygon's vertices
+ * @param color the fill color
+ */
+void render_batch_add_vertices(render_batch_t *batch, const vertex_array_t *points,
+                               rgb_color_t color);
+
+/**
+ * Adds a body's shape in its color.
+ * body_get_shape() copies the shape with malloc on every call, so bodies
+ * drawn every frame should go through render_batch_add_shape() instead.
+ *
+ * @param batch a pointer to a batch returned from render_batch_init()
+ * @param body the body to draw
+ */
+void render_batch_add_body(render_batch_t *batch, body_t *body);
+
+/**
+ * Adds a shape kept relative to a body's centroid, rotated and then moved
+ * to a position.
+ *
+ * @param batch a pointer to a batch returned from render_batch_init()
+ * @param shape the vertices relative to the centroid, unrotated
+ * @param position where the centroid goes
+ * @param rotation how far to rotate the shape, in radians
+ * @param color the fill color
+ */
+void render_batch_add_shape(render_batch_t *batch, const vertex_array_t *shape, vector_t position,
+                            double rotation, rgb_color_t color);
+
+/**
+ * Adds every body in a scene that has not been removed.
+ *
+ * @param batch a pointer to a batch returned from render_batch_init()
+ * @param scene the scene to draw
+ */
+void render_batch_add_scene(render_batch_t *batch, scene_t *scene);
+
+/**
+ * Adds a textured quad in window coordinates,
+ * with the same arguments as SDL_RenderCopyEx().
+ *
+ * @param batch a pointer to a batch returned from render_batch_init()
+ * @param texture the texture to sample
+ * @param src the part of the texture to draw, or NULL for all of it
+ * @param dst where to draw it in the window
+ * @param angle clockwise rotation about the center of dst, in degrees
+ */
+void render_batch_add_sprite(render_batch_t *batch, SDL_Texture *texture,
+                             const SDL_Rect *src, const SDL_Rect *dst, double angle);
+
+/**
+ * Returns the part of the world the view shows, in the window coordinates
+ * sprites are given in, for culling with a spatial index before adding.
+ *
+ * @param batch a pointer to a batch returned from render_batch_init()
+ * @return the visible rectangle, rounded outwards
+ */
+SDL_Rect render_batch_visible_rect(render_batch_t *batch);
+
+/**
+ * Transforms the batched polygons to window coordinates, moves everything
+ * by the camera (see camera.h), submits it to the renderer and empties
+ * the batch.
+ *
+ * @param batch a pointer to a batch returned from render_batch_init()
+ */
+void render_batch_flush(render_batch_t *batch);
+
+/**
+ * Returns the counters for the last flush.
+ *
+ * @param batch a pointer to a batch returned from render_batch_init()
+ * @return a snapshot of the counters
+ */
+render_batch_stats_t render_batch_get_stats(render_batch_t *batch);
+
+/**
+ * Batched replacement for sdl_render_scene():
+ * draws every body in the scene and shows the frame.
+ *
+ * @param scene the scene to draw
+ */
+void render_batch_scene(scene_t *scene);
+
+/**
+ * Shows the frame with sdl_show(), leaving its allocations out of the
+ * steady-state malloc check (see frame_alloc.h).
+ * Call it instead of sdl_show() after flushing.
+ */
+void render_batch_present(void);
+
+#endif
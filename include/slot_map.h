@@ -0,0 +1,112 @@
+#ifndef __SLOT_MAP_H__
+#define __SLOT_MAP_H__
+
+#include "body.h"
+#include "color.h"
+#include "list.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * A stable reference to a body: a slot index plus the generation the slot
+ * had when the body was created. Once the body is removed or freed the
+ * slot's generation moves on and the handle is detected as stale.
+ */
+typedef struct body_handle {
+    uint32_t index;
+    uint32_t generation;
+} body_handle_t;
+
+// A handle that never refers to a body
+#define BODY_HANDLE_NULL ((body_handle_t){.index = 0, .generation = 0})
+
+/**
+ * Slot map of bodies, giving O(1) insert, lookup and removal by handle.
+ * Bodies are still owned by the scene they are added to; the map learns
+ * that a body was freed through the body's info freer, so it must be
+ * freed after any scene holding its bodies.
+ */
+typedef struct slot_map slot_map_t;
+
+/**
+ * Allocates an empty slot map.
+ *
+ * @param initial_size the number of slots to reserve
+ * @return a pointer to the new map
+ */
+slot_map_t *slot_map_init(size_t initial_size);
+
+/**
+ * Frees a slot map. Free scenes holding its bodies first.
+ *
+ * @param map a pointer to a map returned from slot_map_init()
+ */
+void slot_map_free(slot_map_t *map);
+
+/**
+ * Creates a body tracked by the map, like body_init().
+ * The body still has to be added to a scene.
+ *
+ * @param map a pointer to a map returned from slot_map_init()
+ * @param shape the body's shape, as in body_init()
+ * @param mass the body's mass
+ * @param color the body's color
+ * @return a handle to the new body
+ */
+body_handle_t slot_map_body_init(slot_map_t *map, list_t *shape, double mass,
+                                 rgb_color_t color);
+
+/**
+ * Creates a body tracked by the map, like body_init_with_info().
+ * Use slot_map_get_info() to read the info back.
+ *
+ * @param map a pointer to a map returned from slot_map_init()
+ * @param shape the body's shape
+ * @param mass the body's mass
+ * @param color the body's color
+ * @param info additional information to associate with the body
+ * @param info_freer if non-NULL, a function call on the info to free it
+ * @return a handle to the new body
+ */
+body_handle_t slot_map_body_init_with_info(slot_map_t *map, list_t *shape, double mass,
+                                           rgb_color_t color, void *info,
+                                           free_func_t info_freer);
+
+/**
+ * Looks up a body.
+ *
+ * @param map a pointer to a map returned from slot_map_init()
+ * @param handle a handle returned by the map
+ * @return the body, or NULL if the handle is stale or the body was removed
+ */
+body_t *slot_map_get(slot_map_t *map, body_handle_t handle);
+
+/**
+ * Returns the info a body was created with.
+ *
+ * @param map a pointer to a map returned from slot_map_init()
+ * @param handle a handle returned by the map
+ * @return the info, or NULL if the handle is stale
+ */
+void *slot_map_get_info(slot_map_t *map, body_handle_t handle);
+
+/**
+ * Marks a body for removal and invalidates its handle.
+ * The scene frees the body on its next tick.
+ *
+ * @param map a pointer to a map returned from slot_map_init()
+ * @param handle a handle returned by the map
+ * @return whether the handle referred to a live body
+ */
+bool slot_map_remove(slot_map_t *map, body_handle_t handle);
+
+/**
+ * Returns the number of live bodies in the map.
+ *
+ * @param map a pointer to a map returned from slot_map_init()
+ * @return the number of bodies whose handles are still valid
+ */
+size_t slot_map_size(slot_map_t *map);
+
+#endif
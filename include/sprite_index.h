@@ -0,0 +1,77 @@
+#ifndef __SPRITE_INDEX_H__
+#define __SPRITE_INDEX_H__
+
+#include <SDL2/SDL.h>
+#include <stddef.h>
+
+/**
+ * A spatial index of sprites that do not move, such as craters and boulders,
+ * for finding the ones inside the view without looking at the rest.
+ * Entries are kept sorted by their left edge, which suits worlds that
+ * scroll sideways: a query is a binary search plus the entries it returns.
+ */
+typedef struct sprite_index sprite_index_t;
+
+/**
+ * Called for each entry a query finds.
+ *
+ * @param item the item the entry was added with
+ * @param aux the auxiliary value passed to sprite_index_query()
+ */
+typedef void (*sprite_visit_t)(void *item, void *aux);
+
+/**
+ * Counters for the last query.
+ * visited entries overlapped the view; culled ones were skipped.
+ */
+typedef struct sprite_index_stats {
+    size_t entries;
+    size_t visited;
+    size_t culled;
+} sprite_index_stats_t;
+
+/**
+ * Allocates an empty index.
+ *
+ * @return a pointer to the new index
+ */
+sprite_index_t *sprite_index_init(void);
+
+/**
+ * Frees an index. The items are not freed.
+ *
+ * @param index a pointer to an index returned from sprite_index_init()
+ */
+void sprite_index_free(sprite_index_t *index);
+
+/**
+ * Adds a sprite. Its rectangle is copied, so moving the sprite later
+ * means removing and adding it again.
+ *
+ * @param index a pointer to an index returned from sprite_index_init()
+ * @param rect where the sprite is drawn, in world coordinates
+ * @param item the value handed to the visitor
+ */
+void sprite_index_add(sprite_index_t *index, const SDL_Rect *rect, void *item);
+
+/**
+ * Visits every sprite overlapping a rectangle, in the order they were added.
+ *
+ * @param index a pointer to an index returned from sprite_index_init()
+ * @param view the rectangle to search, in world coordinates
+ * @param visit the function to call for each sprite found
+ * @param aux an auxiliary value to pass to visit
+ * @return the number of sprites visited
+ */
+size_t sprite_index_query(sprite_index_t *index, const SDL_Rect *view, sprite_visit_t visit,
+                          void *aux);
+
+/**
+ * Returns the counters for the last query.
+ *
+ * @param index a pointer to an index returned from sprite_index_init()
+ * @return a snapshot of the counters
+ */
+sprite_index_stats_t sprite_index_get_stats(sprite_index_t *index);
+
+#endif
@@ -0,0 +1,52 @@
+// Generated by tools/pack_atlas.py. Do not edit.
+#ifndef __TANK_ATLAS_H__
+#define __TANK_ATLAS_H__
+
+#include <SDL2/SDL.h>
+
+#define TANK_ATLAS_PATH "assets/tank_atlas.png"
+
+#define TANK_HEALTH_TIERS 5
+#define TANK_ANGLE_TIERS 3
+#define TANK_FACINGS 2
+#define TANK_PLAYERS 2
+
+// Source rectangles in the atlas, indexed by
+// [health tier: high, mid2, mid1, low, death]
+// [angle tier: low, mid, high]
+// [facing: left, right]
+// [player: 1, 2]
+// The death tier repeats the same frame for every angle and facing.
+static const SDL_Rect TANK_ATLAS_TANKS[TANK_HEALTH_TIERS][TANK_ANGLE_TIERS][TANK_FACINGS][TANK_PLAYERS] = {
+    { // high
+        {{{2, 2, 200, 149}, {204, 2, 200, 149}}, {{406, 2, 200, 149}, {608, 2, 200, 149}}},
+        {{{810, 2, 200, 149}, {1012, 2, 200, 149}}, {{1214, 2, 200, 149}, {1416, 2, 200, 149}}},
+        {{{1618, 2, 200, 149}, {1820, 2, 200, 149}}, {{2, 153, 200, 149}, {204, 153, 200, 149}}},
+    },
+    { // mid2
+        {{{406, 153, 200, 149}, {608, 153, 200, 149}}, {{810, 153, 200, 149}, {1012, 153, 200, 149}}},
+        {{{1214, 153, 200, 149}, {1416, 153, 200, 149}}, {{1618, 153, 200, 149}, {1820, 153, 200, 149}}},
+        {{{2, 304, 200, 149}, {204, 304, 200, 149}}, {{406, 304, 200, 149}, {608, 304, 200, 149}}},
+    },
+    { // mid1
+        {{{810, 304, 200, 149}, {1012, 304, 200, 149}}, {{1214, 304, 200, 149}, {1416, 304, 200, 149}}},
+        {{{1618, 304, 200, 149}, {1820, 304, 200, 149}}, {{2, 455, 200, 149}, {204, 455, 200, 149}}},
+        {{{406, 455, 200, 149}, {608, 455, 200, 149}}, {{810, 455, 200, 149}, {1012, 455, 200, 149}}},
+    },
+    { // low
+        {{{1214, 455, 200, 149}, {1416, 455, 200, 149}}, {{1618, 455, 200, 149}, {1820, 455, 200, 149}}},
+        {{{2, 606, 200, 149}, {204, 606, 200, 149}}, {{406, 606, 200, 149}, {608, 606, 200, 149}}},
+        {{{810, 606, 200, 149}, {1012, 606, 200, 149}}, {{1214, 606, 200, 149}, {1416, 606, 200, 149}}},
+    },
+    { // death
+        {{{1618, 606, 200, 149}, {1820, 606, 200, 149}}, {{1618, 606, 200, 149}, {1820, 606, 200, 149}}},
+        {{{1618, 606, 200, 149}, {1820, 606, 200, 149}}, {{1618, 606, 200, 149}, {1820, 606, 200, 149}}},
+        {{{1618, 606, 200, 149}, {1820, 606, 200, 149}}, {{1618, 606, 200, 149}, {1820, 606, 200, 149}}},
+    },
+};
+
+static const SDL_Rect TANK_ATLAS_BULLET = {2, 757, 20, 20};
+static const SDL_Rect TANK_ATLAS_CRATER = {24, 757, 100, 100};
+static const SDL_Rect TANK_ATLAS_BOULDER = {126, 757, 60, 42};
+
+#endif
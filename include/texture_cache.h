@@ -0,0 +1,124 @@
+#ifndef __TEXTURE_CACHE_H__
+#define __TEXTURE_CACHE_H__
+
+#include <SDL2/SDL.h>
+#include <stddef.h>
+
+/**
+ * A cache of SDL textures keyed by asset path.
+ * Each asset is decoded once; textures that are no longer referenced are
+ * evicted least-recently-used first once the memory budget is exceeded.
+ */
+typedef struct texture_cache texture_cache_t;
+
+/**
+ * A refcounted handle to a cached texture.
+ * Handles stay valid until they are released with texture_cache_release().
+ */
+typedef struct texture_handle texture_handle_t;
+
+/**
+ * Counters describing how well the cache is doing.
+ * bytes is an estimate of texture memory (width * height * 4).
+ */
+typedef struct texture_cache_stats {
+    size_t hits;
+    size_t misses;
+    size_t evictions;
+    size_t entries;
+    size_t bytes;
+    size_t budget;
+} texture_cache_stats_t;
+
+/**
+ * Allocates an empty texture cache.
+ *
+ * @param renderer the renderer textures are created for
+ * @param budget_bytes the texture memory the cache may keep around
+ * @return a pointer to the new cache
+ */
+texture_cache_t *texture_cache_init(SDL_Renderer *renderer, size_t budget_bytes);
+
+/**
+ * Destroys every texture in the cache and frees the cache.
+ * Outstanding handles become invalid.
+ *
+ * @param cache a pointer to a cache returned from texture_cache_init()
+ */
+void texture_cache_free(texture_cache_t *cache);
+
+/**
+ * Returns the cache shared by all the games, creating it on first use
+ * for the renderer returned by sdl_return_renderer().
+ *
+ * @return the shared texture cache
+ */
+texture_cache_t *texture_cache_shared(void);
+
+/**
+ * Acquires a reference to the texture for an asset, loading it on a miss.
+ * Referenced textures are never evicted.
+ *
+ * @param cache a pointer to a cache returned from texture_cache_init()
+ * @param path the path of the asset, e.g. "assets/bullet.png"
+ * @return a handle to the texture, or NULL if the asset could not be loaded
+ */
+texture_handle_t *texture_cache_acquire(texture_cache_t *cache, const char *path);
+
+/**
+ * Drops a reference acquired with texture_cache_acquire().
+ * The texture stays cached until the budget forces it out.
+ *
+ * @param cache a pointer to a cache returned from texture_cache_init()
+ * @param handle a handle returned from texture_cache_acquire(), or NULL
+ */
+void texture_cache_release(texture_cache_t *cache, texture_handle_t *handle);
+
+/**
+ * Returns the texture behind a handle and marks it as recently used.
+ *
+ * @param handle a handle returned from texture_cache_acquire()
+ * @return the SDL texture
+ */
+SDL_Texture *texture_handle_get(texture_handle_t *handle);
+
+/**
+ * Returns the texture for an asset without keeping a reference to it.
+ * Meant for per-frame draws: the texture is valid until the next call
+ * that may load a new asset into the cache.
+ *
+ * @param cache a pointer to a cache returned from texture_cache_init()
+ * @param path the path of the asset
+ * @return the SDL texture, or NULL if the asset could not be loaded
+ */
+SDL_Texture *texture_cache_get(texture_cache_t *cache, const char *path);
+
+/**
+ * Loads any of a list of assets that are not cached yet, decoding the
+ * images in parallel on the job scheduler (see jobs.h). Only the upload to
+ * the renderer runs on the calling thread. Later acquires of these paths
+ * are hits, unless the budget evicts them first.
+ *
+ * @param cache a pointer to a cache returned from texture_cache_init()
+ * @param paths the paths of the assets
+ * @param count the number of paths
+ */
+void texture_cache_preload(texture_cache_t *cache, const char *const *paths, size_t count);
+
+/**
+ * Changes the memory budget, evicting unreferenced textures if needed.
+ *
+ * @param cache a pointer to a cache returned from texture_cache_init()
+ * @param budget_bytes the new budget
+ */
+void texture_cache_set_budget(texture_cache_t *cache, size_t budget_bytes);
+
+/**
+ * Returns the cache's counters.
+ *
+ * @param cache a pointer to a cache returned from texture_cache_init()
+ * @return a snapshot of the counters
+ */
+texture_cache_stats_t texture_cache_get_stats(texture_cache_t *cache);
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef __VERTEX_ARRAY_H__
+#define __VERTEX_ARRAY_H__
+
+#include "arena.h"
+#include "list.h"
+#include "vector.h"
+#include <stddef.h>
+
+/**
+ * A polygon's vertices packed after their count in one allocation.
+ * Used where shapes are read in tight loops; list_t shapes are converted
+ * once at the boundary with vertex_array_from_list().
+ */
+typedef struct vertex_array {
+    size_t size;
+    vector_t points[];
+} vertex_array_t;
+
+/**
+ * Allocates a vertex array with uninitialized points.
+ *
+ * @param size the number of vertices
+ * @return a pointer to the new array
+ */
+vertex_array_t *vertex_array_init(size_t size);
+
+/**
+ * Copies a list of vector_t pointers, such as a body's shape, into a new array.
+ *
+ * @param list the list to copy; it is not freed
+ * @return a pointer to the new array
+ */
+vertex_array_t *vertex_array_from_list(list_t *list);
+
+/**
+ * Allocates a vertex array with uninitialized points from an arena,
+ * such as frame_arena() for arrays that only live for one frame.
+ * The array is released with the arena, not vertex_array_free().
+ *
+ * @param arena the arena to allocate from
+ * @param size the number of vertices
+ * @return a pointer to the new array
+ */
+vertex_array_t *vertex_array_init_in(arena_t *arena, size_t size);
+
+/**
+ * Copies a list of vector_t pointers into a new array allocated from an arena.
+ *
+ * @param arena the arena to allocate from
+ * @param list the list to copy; it is not freed
+ * @return a pointer to the new array
+ */
+vertex_array_t *vertex_array_from_list_in(arena_t *arena, list_t *list);
+
+/**
+ * Frees a vertex array.
+ *
+ * @param array a pointer to an array returned from vertex_array_init()
+ */
+void vertex_array_free(vertex_array_t *array);
+
+#endif
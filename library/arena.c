@@ -0,0 +1,115 @@
+#include "arena.h"
+#include <assert.h>
+#include <stdalign.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+const size_t ARENA_ALIGNMENT = alignof(max_align_t);
+
+// Chunks form a list, newest first; data follows the header
+typedef struct arena_chunk {
+    struct arena_chunk *next;
+    size_t size;
+    size_t used;
+    alignas(max_align_t) unsigned char data[];
+} arena_chunk_t;
+
+typedef struct arena {
+    arena_chunk_t *chunks;
+    // The chunk made by arena_init(), kept by arena_reset()
+    arena_chunk_t *first;
+    size_t chunk_size;
+    arena_stats_t stats;
+} arena_t;
+
+static arena_chunk_t *chunk_init(size_t size, arena_chunk_t *next) {
+    arena_chunk_t *chunk = malloc(sizeof(arena_chunk_t) + size);
+    assert(chunk != NULL);
+    chunk->next = next;
+    chunk->size = size;
+    chunk->used = 0;
+    return chunk;
+}
+
+static void update_peaks(arena_stats_t *stats) {
+    if (stats->used > stats->peak_used) {
+        stats->peak_used = stats->used;
+    }
+    if (stats->reserved > stats->peak_reserved) {
+        stats->peak_reserved = stats->reserved;
+    }
+}
+
+arena_t *arena_init(size_t chunk_size) {
+    arena_t *arena = malloc(sizeof(arena_t));
+    assert(arena != NULL);
+    arena->chunk_size = chunk_size;
+    arena->chunks = chunk_init(chunk_size, NULL);
+    arena->first = arena->chunks;
+    arena->stats = (arena_stats_t){.reserved = chunk_size, .chunks = 1};
+    update_peaks(&arena->stats);
+    return arena;
+}
+
+void arena_free(arena_t *arena) {
+    arena_chunk_t *chunk = arena->chunks;
+    while (chunk != NULL) {
+        arena_chunk_t *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    free(arena);
+}
+
+void *arena_alloc(arena_t *arena, size_t size) {
+    size_t aligned = (size + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1);
+    arena_chunk_t *chunk = arena->chunks;
+    if (chunk->size - chunk->used < aligned) {
+        if (aligned > arena->chunk_size) {
+            // Oversized allocations get a chunk behind the current one,
+            // so the current one keeps filling up
+            arena_chunk_t *big = chunk_init(aligned, chunk->next);
+            big->used = aligned;
+            chunk->next = big;
+            arena->stats.used += aligned;
+            arena->stats.reserved += aligned;
+            arena->stats.chunks++;
+            update_peaks(&arena->stats);
+            return big->data;
+        }
+        chunk = chunk_init(arena->chunk_size, chunk);
+        arena->chunks = chunk;
+        arena->stats.reserved += arena->chunk_size;
+        arena->stats.chunks++;
+    }
+
+    void *result = chunk->data + chunk->used;
+    chunk->used += aligned;
+    arena->stats.used += aligned;
+    update_peaks(&arena->stats);
+    return result;
+}
+
+void arena_reset(arena_t *arena) {
+    arena_chunk_t *chunk = arena->chunks;
+    while (chunk != NULL) {
+        arena_chunk_t *next = chunk->next;
+        if (chunk != arena->first) {
+            free(chunk);
+        }
+        chunk = next;
+    }
+    arena->chunks = arena->first;
+    arena->first->next = NULL;
+    arena->first->used = 0;
+    arena->stats.used = 0;
+    arena->stats.reserved = arena->first->size;
+    arena->stats.chunks = 1;
+}
+
+arena_stats_t arena_get_stats(arena_t *arena) {
+    return arena->stats;
+}
+
+void arena_no_free(void *value) {
+}
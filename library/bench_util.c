@@ -0,0 +1,203 @@
+#include "bench_util.h"
+#include <assert.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Target duration of one sample
+const double BENCH_SAMPLE_NS = 1e6;
+const size_t BENCH_SAMPLES = 101;
+const size_t BENCH_MAX_BATCH = (size_t)1 << 30;
+
+typedef struct bench_result {
+    char *name;
+    size_t ops;
+    double ns_per_op;
+    double p50_ns;
+    double p90_ns;
+    double p99_ns;
+    double allocs_per_op;
+    double bytes_per_op;
+} bench_result_t;
+
+typedef struct bench_suite {
+    const char *name;
+    const char *json_path;
+    bench_result_t *results;
+    size_t size;
+    size_t capacity;
+} bench_suite_t;
+
+static bench_suite_t suite;
+
+// Heap traffic of the code under test, counted by the malloc wrappers.
+// The bench link passes -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc.
+static size_t alloc_count = 0;
+static size_t alloc_bytes = 0;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+void *__wrap_malloc(size_t size) {
+    alloc_count++;
+    alloc_bytes += size;
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size) {
+    alloc_count++;
+    alloc_bytes += count * size;
+    return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size) {
+    alloc_count++;
+    alloc_bytes += size;
+    return __real_realloc(ptr, size);
+}
+
+static volatile double bench_sink;
+
+void bench_consume(double value) {
+    bench_sink = value;
+}
+
+list_t *bench_polygon(size_t sides, double radius, vector_t center) {
+    list_t *points = list_init(sides, free);
+    for (size_t i = 0; i < sides; i++) {
+        double angle = 2 * M_PI * i / sides;
+        vector_t *point = malloc(sizeof(vector_t));
+        assert(point != NULL);
+        point->x = center.x + radius * cos(angle);
+        point->y = center.y + radius * sin(angle);
+        list_add(points, point);
+    }
+    return points;
+}
+
+static double now_ns(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec * 1e9 + time.tv_nsec;
+}
+
+static int compare_doubles(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static double percentile(double *sorted, size_t size, double fraction) {
+    return sorted[(size_t)(fraction * (size - 1) + 0.5)];
+}
+
+void bench_init(int argc, char **argv, const char *name) {
+    suite.name = name;
+    suite.json_path = NULL;
+    suite.size = 0;
+    suite.capacity = 16;
+    suite.results = malloc(suite.capacity * sizeof(bench_result_t));
+    assert(suite.results != NULL);
+
+    for (int i = 1; i + 1 < argc; i++) {
+        if (strcmp(argv[i], "--json") == 0) {
+            suite.json_path = argv[i + 1];
+        }
+    }
+
+    printf("%-32s %12s %12s %12s %12s %10s %10s\n", name, "ns/op", "p50", "p90", "p99",
+           "allocs/op", "bytes/op");
+}
+
+void bench_run(const char *name, bench_func_t func, void *aux) {
+    // Warm up and grow the batch until a sample is long enough to time
+    size_t batch = 1;
+    while (true) {
+        double start = now_ns();
+        func(aux, batch);
+        double elapsed = now_ns() - start;
+        if (elapsed >= BENCH_SAMPLE_NS || batch >= BENCH_MAX_BATCH) {
+            break;
+        }
+        batch *= elapsed < BENCH_SAMPLE_NS / 16 ? 8 : 2;
+    }
+
+    double *samples = malloc(BENCH_SAMPLES * sizeof(double));
+    assert(samples != NULL);
+    double total_ns = 0.0;
+    size_t allocs_before = alloc_count;
+    size_t bytes_before = alloc_bytes;
+    for (size_t i = 0; i < BENCH_SAMPLES; i++) {
+        double start = now_ns();
+        func(aux, batch);
+        double elapsed = now_ns() - start;
+        samples[i] = elapsed / batch;
+        total_ns += elapsed;
+    }
+    size_t total_ops = batch * BENCH_SAMPLES;
+    // The samples array itself is allocated outside the counted window
+    size_t allocs = alloc_count - allocs_before;
+    size_t bytes = alloc_bytes - bytes_before;
+
+    qsort(samples, BENCH_SAMPLES, sizeof(double), compare_doubles);
+    bench_result_t result = {
+        .name = malloc(strlen(name) + 1),
+        .ops = total_ops,
+        .ns_per_op = total_ns / total_ops,
+        .p50_ns = percentile(samples, BENCH_SAMPLES, 0.5),
+        .p90_ns = percentile(samples, BENCH_SAMPLES, 0.9),
+        .p99_ns = percentile(samples, BENCH_SAMPLES, 0.99),
+        .allocs_per_op = (double)allocs / total_ops,
+        .bytes_per_op = (double)bytes / total_ops,
+    };
+    free(samples);
+    assert(result.name != NULL);
+    strcpy(result.name, name);
+
+    if (suite.size == suite.capacity) {
+        suite.capacity *= 2;
+        suite.results = realloc(suite.results, suite.capacity * sizeof(bench_result_t));
+        assert(suite.results != NULL);
+    }
+    suite.results[suite.size++] = result;
+
+    printf("%-32s %12.1f %12.1f %12.1f %12.1f %10.2f %10.1f\n", name, result.ns_per_op,
+           result.p50_ns, result.p90_ns, result.p99_ns, result.allocs_per_op,
+           result.bytes_per_op);
+    fflush(stdout);
+}
+
+static bool write_json(const char *path) {
+    FILE *file = fopen(path, "w");
+    if (file == NULL) {
+        fprintf(stderr, "could not open %s for writing\n", path);
+        return false;
+    }
+    fprintf(file, "{\n  \"suite\": \"%s\",\n  \"results\": [\n", suite.name);
+    for (size_t i = 0; i < suite.size; i++) {
+        bench_result_t *result = &suite.results[i];
+        fprintf(file,
+                "    {\"name\": \"%s\", \"ops\": %zu, \"ns_per_op\": %.3f, "
+                "\"p50_ns\": %.3f, \"p90_ns\": %.3f, \"p99_ns\": %.3f, "
+                "\"allocs_per_op\": %.4f, \"bytes_per_op\": %.2f}%s\n",
+                result->name, result->ops, result->ns_per_op, result->p50_ns,
+                result->p90_ns, result->p99_ns, result->allocs_per_op, result->bytes_per_op,
+                i + 1 < suite.size ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+    fclose(file);
+    return true;
+}
+
+int bench_finish(void) {
+    bool ok = suite.json_path == NULL || write_json(suite.json_path);
+    for (size_t i = 0; i < suite.size; i++) {
+        free(suite.results[i].name);
+    }
+    free(suite.results);
+    return ok ? 0 : 1;
+}
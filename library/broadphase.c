@@ -0,0 +1,971 @@
+#include "broadphase.h"
+#include "frame_alloc.h"
+#include "parallel.h"
+#include "perf_counters.h"
+#include "pool.h"
+#include "profile.h"
+#include "ptr_map.h"
+#include "vector.h"
+#include "vertex_array.h"
+#include <assert.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+const size_t BROADPHASE_INITIAL_SIZE = 16;
+// Pairs allocated at a time by the pair pool
+const size_t BROADPHASE_PAIR_CHUNK = 256;
+// Iterations per parallel_for() chunk; smaller scenes run on one thread
+const size_t BROADPHASE_PROXY_GRAIN = 128;
+const size_t BROADPHASE_CHECK_GRAIN = 64;
+
+// Vertices and edge normals relative to the centroid, at a given rotation.
+// Bodies with the same shape, such as every platform, share one template.
+typedef struct shape_template {
+    vertex_array_t *points;
+    vertex_array_t *normals;
+    double rotation;
+    double min_x;
+    double min_y;
+    double max_x;
+    double max_y;
+    size_t hash;
+    size_t refs;
+} shape_template_t;
+
+typedef struct pair pair_t;
+
+// A tracked body: its shape template plus the transform it was last seen at.
+// World-space vertices are only produced when a narrowphase test needs them.
+// Slots of dropped proxies have a NULL body until they are reused.
+typedef struct proxy {
+    body_t *body;
+    // Every pair the body is in, so removing it touches only those
+    pair_t *pairs;
+    size_t degree;
+    shape_template_t *shape;
+    // Set until the first update after the shape was attached
+    bool fresh;
+    // Set by the prune while the body is found in the scene
+    bool in_scene;
+    bool dirty;
+    // Set when a separating axis test this tick needs the world vertices
+    bool needed;
+    vector_t centroid;
+    double rotation;
+    bool world_valid;
+    vertex_array_t *points;
+    // The template's normals while unrotated, otherwise rotated_normals
+    const vertex_array_t *normals;
+    vertex_array_t *rotated_normals;
+    double min_x;
+    double min_y;
+    double max_x;
+    double max_y;
+} proxy_t;
+
+// A registered handler, allocated from the pair pool. Each pair is linked
+// into both proxies' lists (index 0 for proxy1, 1 for proxy2) and into the
+// chain of pairs with the same two bodies.
+typedef struct pair {
+    size_t proxy1;
+    size_t proxy2;
+    collision_handler_t handler;
+    void *aux;
+    free_func_t freer;
+    // Registration order, which handlers fire in
+    uint64_t serial;
+    // Position in the broadphase's live array
+    size_t live_index;
+    bool collided;
+    bool tested;
+    bool tested_before;
+    // Dropped by broadphase_remove_collisions(); freed by the next prune
+    bool removed;
+    struct pair *next;
+    struct pair *prev_of[2];
+    struct pair *next_of[2];
+} pair_t;
+
+// A separating axis test to run this tick and its result.
+// Tests run in parallel, then handlers fire in order from these results.
+typedef struct check {
+    pair_t *pair;
+    bool collided;
+    vector_t axis;
+} check_t;
+
+// Two proxies whose boxes overlap, with proxy1 < proxy2
+typedef struct candidate {
+    size_t proxy1;
+    size_t proxy2;
+} candidate_t;
+
+typedef struct grid_entry {
+    long cell_x;
+    long cell_y;
+    size_t proxy;
+} grid_entry_t;
+
+typedef struct pair_slot {
+    size_t proxy1;
+    size_t proxy2;
+    pair_t *head;
+} pair_slot_t;
+
+typedef struct broadphase {
+    scene_t *scene;
+    broadphase_kind_t kind;
+    double cell_size;
+
+    // Proxy slots, live or free; indices stay put while a proxy lives
+    proxy_t *proxies;
+    size_t num_proxies;
+    size_t proxy_capacity;
+    size_t num_live_proxies;
+    size_t *free_proxies;
+    size_t num_free_proxies;
+    size_t free_proxy_capacity;
+    // Live proxies sorted by min_x, kept between ticks so re-sorting is cheap
+    size_t *order;
+    size_t num_order;
+    size_t order_capacity;
+    // Set when a proxy was dropped and order still lists its slot
+    bool order_stale;
+
+    pool_t *pair_pool;
+    pair_t **live;
+    size_t num_pairs;
+    size_t live_capacity;
+    uint64_t next_serial;
+    // Pairs flagged by broadphase_remove_collisions() for the next prune
+    pair_t **dead_pairs;
+    size_t num_dead_pairs;
+    size_t dead_pair_capacity;
+
+    shape_template_t **templates;
+    size_t num_templates;
+    size_t template_capacity;
+
+    // Each tracked body's proxy, and an open-addressed map from proxy pair
+    // to pair chain
+    ptr_map_t *body_proxies;
+    pair_slot_t *pair_slots;
+    size_t pair_slot_capacity;
+    size_t num_pair_keys;
+
+    // Scratch space reused every tick
+    candidate_t *candidates;
+    size_t num_candidates;
+    size_t candidate_capacity;
+    grid_entry_t *grid;
+    size_t num_grid;
+    size_t grid_capacity;
+    pair_t **tests;
+    size_t num_tests;
+    size_t test_capacity;
+    check_t *checks;
+    size_t num_checks;
+    size_t check_capacity;
+
+    broadphase_stats_t stats;
+} broadphase_t;
+
+static size_t pair_hash(size_t proxy1, size_t proxy2) {
+    return ptr_map_hash(((uint64_t)proxy1 << 32) ^ proxy2);
+}
+
+static size_t pair_slot_find(broadphase_t *broadphase, size_t proxy1, size_t proxy2) {
+    size_t mask = broadphase->pair_slot_capacity - 1;
+    size_t i = pair_hash(proxy1, proxy2) & mask;
+    while (broadphase->pair_slots[i].head != NULL &&
+           (broadphase->pair_slots[i].proxy1 != proxy1 || broadphase->pair_slots[i].proxy2 != proxy2)) {
+        i = (i + 1) & mask;
+    }
+    return i;
+}
+
+static size_t pair_slot_of(broadphase_t *broadphase, pair_t *pair) {
+    size_t lo = pair->proxy1 < pair->proxy2 ? pair->proxy1 : pair->proxy2;
+    size_t hi = pair->proxy1 < pair->proxy2 ? pair->proxy2 : pair->proxy1;
+    return pair_slot_find(broadphase, lo, hi);
+}
+
+static void pair_slot_delete(broadphase_t *broadphase, size_t i) {
+    pair_slot_t *slots = broadphase->pair_slots;
+    size_t mask = broadphase->pair_slot_capacity - 1;
+    for (size_t j = (i + 1) & mask; slots[j].head != NULL; j = (j + 1) & mask) {
+        if (ptr_map_can_shift(i, j, pair_hash(slots[j].proxy1, slots[j].proxy2) & mask)) {
+            slots[i] = slots[j];
+            i = j;
+        }
+    }
+    slots[i].head = NULL;
+}
+
+// Links a pair into the chain for its two proxies
+static void pair_slot_insert(broadphase_t *broadphase, pair_t *pair) {
+    pair_slot_t *slot = &broadphase->pair_slots[pair_slot_of(broadphase, pair)];
+    if (slot->head == NULL) {
+        slot->proxy1 = pair->proxy1 < pair->proxy2 ? pair->proxy1 : pair->proxy2;
+        slot->proxy2 = pair->proxy1 < pair->proxy2 ? pair->proxy2 : pair->proxy1;
+        broadphase->num_pair_keys++;
+    }
+    pair->next = slot->head;
+    slot->head = pair;
+}
+
+static void pair_slot_unlink(broadphase_t *broadphase, pair_t *pair) {
+    size_t i = pair_slot_of(broadphase, pair);
+    pair_t **link = &broadphase->pair_slots[i].head;
+    while (*link != pair) {
+        link = &(*link)->next;
+    }
+    *link = pair->next;
+    if (broadphase->pair_slots[i].head == NULL) {
+        pair_slot_delete(broadphase, i);
+        broadphase->num_pair_keys--;
+    }
+}
+
+static void rebuild_pair_slots(broadphase_t *broadphase, size_t min_keys) {
+    size_t capacity = BROADPHASE_INITIAL_SIZE;
+    while (capacity < min_keys * 2) {
+        capacity *= 2;
+    }
+    if (capacity != broadphase->pair_slot_capacity) {
+        broadphase->pair_slots = realloc(broadphase->pair_slots, capacity * sizeof(pair_slot_t));
+        assert(broadphase->pair_slots != NULL);
+        broadphase->pair_slot_capacity = capacity;
+    }
+    for (size_t i = 0; i < capacity; i++) {
+        broadphase->pair_slots[i].head = NULL;
+    }
+    broadphase->num_pair_keys = 0;
+    for (size_t i = 0; i < broadphase->num_pairs; i++) {
+        pair_slot_insert(broadphase, broadphase->live[i]);
+    }
+}
+
+static size_t hash_bytes(const void *data, size_t size, size_t hash) {
+    const unsigned char *bytes = data;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ bytes[i]) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+// Finds or creates the template for a body's current shape
+static shape_template_t *template_acquire(broadphase_t *broadphase, body_t *body) {
+    // Looked up in scratch memory; only a new template copies it to the heap
+    list_t *shape = body_get_shape(body);
+    vertex_array_t *points = vertex_array_from_list_in(frame_arena(), shape);
+    list_free(shape);
+    vector_t centroid = body_get_centroid(body);
+    double rotation = body_get_rotation(body);
+    size_t n = points->size;
+    for (size_t i = 0; i < n; i++) {
+        points->points[i] = vec_subtract(points->points[i], centroid);
+    }
+
+    size_t hash = hash_bytes(&rotation, sizeof(double), 14695981039346656037ULL);
+    hash = hash_bytes(points->points, n * sizeof(vector_t), hash);
+    for (size_t i = 0; i < broadphase->num_templates; i++) {
+        shape_template_t *template = broadphase->templates[i];
+        if (template->hash == hash && template->points->size == n && template->rotation == rotation &&
+            memcmp(template->points->points, points->points, n * sizeof(vector_t)) == 0) {
+            template->refs++;
+            return template;
+        }
+    }
+
+    shape_template_t *template = malloc(sizeof(shape_template_t));
+    assert(template != NULL);
+    template->points = vertex_array_init(n);
+    memcpy(template->points->points, points->points, n * sizeof(vector_t));
+    template->normals = vertex_array_init(n);
+    template->rotation = rotation;
+    template->hash = hash;
+    template->refs = 1;
+    template->min_x = INFINITY;
+    template->min_y = INFINITY;
+    template->max_x = -INFINITY;
+    template->max_y = -INFINITY;
+    const vector_t *local = points->points;
+    for (size_t i = 0; i < n; i++) {
+        template->min_x = fmin(template->min_x, local[i].x);
+        template->min_y = fmin(template->min_y, local[i].y);
+        template->max_x = fmax(template->max_x, local[i].x);
+        template->max_y = fmax(template->max_y, local[i].y);
+        // Unit edge normal, computed the same way as in collision.c
+        vector_t edge = vec_subtract(local[(i + 1) % n], local[i]);
+        double scale = 1.0 / sqrt(edge.y * edge.y + edge.x * edge.x);
+        template->normals->points[i] = vec_multiply(scale, (vector_t){.x = -edge.y, .y = edge.x});
+    }
+
+    broadphase->templates = array_grow(broadphase->templates, &broadphase->template_capacity,
+                                       broadphase->num_templates + 1, sizeof(shape_template_t *));
+    broadphase->templates[broadphase->num_templates++] = template;
+    return template;
+}
+
+static void template_release(broadphase_t *broadphase, shape_template_t *template) {
+    if (--template->refs > 0) {
+        return;
+    }
+    for (size_t i = 0; i < broadphase->num_templates; i++) {
+        if (broadphase->templates[i] == template) {
+            broadphase->templates[i] = broadphase->templates[--broadphase->num_templates];
+            break;
+        }
+    }
+    vertex_array_free(template->points);
+    vertex_array_free(template->normals);
+    free(template);
+}
+
+static void proxy_release(broadphase_t *broadphase, proxy_t *proxy) {
+    if (proxy->shape != NULL) {
+        template_release(broadphase, proxy->shape);
+    }
+    if (proxy->points != NULL) {
+        vertex_array_free(proxy->points);
+    }
+    if (proxy->rotated_normals != NULL) {
+        vertex_array_free(proxy->rotated_normals);
+    }
+}
+
+static size_t proxy_for(broadphase_t *broadphase, body_t *body) {
+    size_t index;
+    if (ptr_map_get(broadphase->body_proxies, body, &index)) {
+        return index;
+    }
+
+    if (broadphase->num_free_proxies > 0) {
+        index = broadphase->free_proxies[--broadphase->num_free_proxies];
+    } else {
+        index = broadphase->num_proxies++;
+        broadphase->proxies = array_grow(broadphase->proxies, &broadphase->proxy_capacity,
+                                         broadphase->num_proxies, sizeof(proxy_t));
+    }
+    broadphase->proxies[index] = (proxy_t){.body = body, .pairs = NULL, .degree = 0, .shape = NULL,
+                                           .points = NULL, .rotated_normals = NULL};
+    broadphase->order = array_grow(broadphase->order, &broadphase->order_capacity,
+                                   broadphase->num_order + 1, sizeof(size_t));
+    broadphase->order[broadphase->num_order++] = index;
+    broadphase->num_live_proxies++;
+    ptr_map_put(broadphase->body_proxies, body, index);
+    return index;
+}
+
+// Frees a proxy's slot once its last pair is gone. The slot is reused
+// after the prune takes it out of the sort order.
+static void proxy_drop(broadphase_t *broadphase, size_t index) {
+    proxy_t *proxy = &broadphase->proxies[index];
+    proxy_release(broadphase, proxy);
+    ptr_map_remove(broadphase->body_proxies, proxy->body);
+    proxy->body = NULL;
+    proxy->shape = NULL;
+    proxy->points = NULL;
+    proxy->rotated_normals = NULL;
+    broadphase->num_live_proxies--;
+    broadphase->order_stale = true;
+}
+
+static size_t pair_side(pair_t *pair, size_t proxy) {
+    return pair->proxy1 == proxy ? 0 : 1;
+}
+
+static void proxy_link(broadphase_t *broadphase, size_t index, pair_t *pair) {
+    proxy_t *proxy = &broadphase->proxies[index];
+    size_t side = pair_side(pair, index);
+    pair->prev_of[side] = NULL;
+    pair->next_of[side] = proxy->pairs;
+    if (proxy->pairs != NULL) {
+        proxy->pairs->prev_of[pair_side(proxy->pairs, index)] = pair;
+    }
+    proxy->pairs = pair;
+    proxy->degree++;
+}
+
+static void proxy_unlink(broadphase_t *broadphase, size_t index, pair_t *pair) {
+    proxy_t *proxy = &broadphase->proxies[index];
+    size_t side = pair_side(pair, index);
+    pair_t *prev = pair->prev_of[side];
+    pair_t *next = pair->next_of[side];
+    if (prev != NULL) {
+        prev->next_of[pair_side(prev, index)] = next;
+    } else {
+        proxy->pairs = next;
+    }
+    if (next != NULL) {
+        next->prev_of[pair_side(next, index)] = prev;
+    }
+    if (--proxy->degree == 0) {
+        proxy_drop(broadphase, index);
+    }
+}
+
+// Unlinks a pair from every structure that references it and frees it,
+// dropping either proxy it was the last pair of
+static void pair_drop(broadphase_t *broadphase, pair_t *pair) {
+    pair_slot_unlink(broadphase, pair);
+    pair_t *last = broadphase->live[--broadphase->num_pairs];
+    broadphase->live[pair->live_index] = last;
+    last->live_index = pair->live_index;
+    proxy_unlink(broadphase, pair->proxy1, pair);
+    proxy_unlink(broadphase, pair->proxy2, pair);
+    if (pair->freer != NULL) {
+        pair->freer(pair->aux);
+    }
+    pool_release(broadphase->pair_pool, pair);
+}
+
+// Drops flagged pairs and the pairs of bodies that were removed or are
+// gone from the scene. Bodies are only read once found in the scene, so
+// one freed since the last prune is dropped without being touched. Each
+// removal costs the number of pairs involved; nothing is compacted or
+// rehashed.
+static void broadphase_prune(broadphase_t *broadphase) {
+    for (size_t i = 0; i < broadphase->num_dead_pairs; i++) {
+        pair_drop(broadphase, broadphase->dead_pairs[i]);
+    }
+    broadphase->num_dead_pairs = 0;
+
+    for (size_t i = 0; i < broadphase->num_proxies; i++) {
+        broadphase->proxies[i].in_scene = false;
+    }
+    size_t body_count = scene_bodies(broadphase->scene);
+    for (size_t i = 0; i < body_count; i++) {
+        body_t *body = scene_get_body(broadphase->scene, i);
+        size_t index;
+        if (ptr_map_get(broadphase->body_proxies, body, &index) && !body_is_removed(body)) {
+            broadphase->proxies[index].in_scene = true;
+        }
+    }
+    for (size_t i = 0; i < broadphase->num_proxies; i++) {
+        if (broadphase->proxies[i].body != NULL && !broadphase->proxies[i].in_scene) {
+            // The last pair dropped also drops this proxy
+            while (broadphase->proxies[i].body != NULL) {
+                pair_drop(broadphase, broadphase->proxies[i].pairs);
+            }
+        }
+    }
+
+    if (!broadphase->order_stale) {
+        return;
+    }
+    // Keep the sort order of the survivors and free the dropped slots
+    size_t num_order = 0;
+    for (size_t i = 0; i < broadphase->num_order; i++) {
+        size_t index = broadphase->order[i];
+        if (broadphase->proxies[index].body != NULL) {
+            broadphase->order[num_order++] = index;
+        } else {
+            broadphase->free_proxies = array_grow(broadphase->free_proxies,
+                                                  &broadphase->free_proxy_capacity,
+                                                  broadphase->num_free_proxies + 1, sizeof(size_t));
+            broadphase->free_proxies[broadphase->num_free_proxies++] = index;
+        }
+    }
+    broadphase->num_order = num_order;
+    broadphase->order_stale = false;
+}
+
+static void add_candidate(broadphase_t *broadphase, size_t proxy1, size_t proxy2) {
+    broadphase->candidates = array_grow(broadphase->candidates, &broadphase->candidate_capacity,
+                                        broadphase->num_candidates + 1, sizeof(candidate_t));
+    broadphase->candidates[broadphase->num_candidates++] = (candidate_t){
+        .proxy1 = proxy1 < proxy2 ? proxy1 : proxy2,
+        .proxy2 = proxy1 < proxy2 ? proxy2 : proxy1,
+    };
+}
+
+static bool boxes_overlap_y(proxy_t *a, proxy_t *b) {
+    return a->min_y <= b->max_y && b->min_y <= a->max_y;
+}
+
+static void find_pairs_sweep(broadphase_t *broadphase) {
+    proxy_t *proxies = broadphase->proxies;
+    size_t *order = broadphase->order;
+    size_t n = broadphase->num_order;
+
+    // Bodies move little between ticks, so insertion sort is close to linear
+    for (size_t i = 1; i < n; i++) {
+        size_t key = order[i];
+        size_t j = i;
+        while (j > 0 && proxies[order[j - 1]].min_x > proxies[key].min_x) {
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = key;
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        proxy_t *a = &proxies[order[i]];
+        for (size_t j = i + 1; j < n && proxies[order[j]].min_x <= a->max_x; j++) {
+            if (boxes_overlap_y(a, &proxies[order[j]])) {
+                add_candidate(broadphase, order[i], order[j]);
+            }
+        }
+    }
+}
+
+static int compare_grid_entries(const void *a, const void *b) {
+    const grid_entry_t *entry1 = a;
+    const grid_entry_t *entry2 = b;
+    if (entry1->cell_x != entry2->cell_x) {
+        return entry1->cell_x < entry2->cell_x ? -1 : 1;
+    }
+    if (entry1->cell_y != entry2->cell_y) {
+        return entry1->cell_y < entry2->cell_y ? -1 : 1;
+    }
+    return entry1->proxy < entry2->proxy ? -1 : entry1->proxy > entry2->proxy;
+}
+
+static long grid_cell(broadphase_t *broadphase, double coordinate) {
+    return (long)floor(coordinate / broadphase->cell_size);
+}
+
+static void find_pairs_grid(broadphase_t *broadphase) {
+    proxy_t *proxies = broadphase->proxies;
+
+    broadphase->num_grid = 0;
+    for (size_t i = 0; i < broadphase->num_proxies; i++) {
+        if (proxies[i].body == NULL) {
+            continue;
+        }
+        long x0 = grid_cell(broadphase, proxies[i].min_x);
+        long x1 = grid_cell(broadphase, proxies[i].max_x);
+        long y0 = grid_cell(broadphase, proxies[i].min_y);
+        long y1 = grid_cell(broadphase, proxies[i].max_y);
+        size_t cells = (size_t)(x1 - x0 + 1) * (size_t)(y1 - y0 + 1);
+        broadphase->grid = array_grow(broadphase->grid, &broadphase->grid_capacity,
+                                      broadphase->num_grid + cells, sizeof(grid_entry_t));
+        for (long x = x0; x <= x1; x++) {
+            for (long y = y0; y <= y1; y++) {
+                broadphase->grid[broadphase->num_grid++] = (grid_entry_t){x, y, i};
+            }
+        }
+    }
+    qsort(broadphase->grid, broadphase->num_grid, sizeof(grid_entry_t), compare_grid_entries);
+
+    size_t start = 0;
+    while (start < broadphase->num_grid) {
+        grid_entry_t *cell = &broadphase->grid[start];
+        size_t end = start + 1;
+        while (end < broadphase->num_grid && broadphase->grid[end].cell_x == cell->cell_x &&
+               broadphase->grid[end].cell_y == cell->cell_y) {
+            end++;
+        }
+        for (size_t i = start; i < end; i++) {
+            proxy_t *a = &proxies[broadphase->grid[i].proxy];
+            for (size_t j = i + 1; j < end; j++) {
+                proxy_t *b = &proxies[broadphase->grid[j].proxy];
+                if (a->min_x > b->max_x || b->min_x > a->max_x || !boxes_overlap_y(a, b)) {
+                    continue;
+                }
+                // Report each pair only from the first cell both boxes share
+                long home_x = grid_cell(broadphase, fmax(a->min_x, b->min_x));
+                long home_y = grid_cell(broadphase, fmax(a->min_y, b->min_y));
+                if (home_x == cell->cell_x && home_y == cell->cell_y) {
+                    add_candidate(broadphase, broadphase->grid[i].proxy, broadphase->grid[j].proxy);
+                }
+            }
+        }
+        start = end;
+    }
+}
+
+static int compare_serials(const void *a, const void *b) {
+    uint64_t serial1 = (*(pair_t *const *)a)->serial;
+    uint64_t serial2 = (*(pair_t *const *)b)->serial;
+    return serial1 < serial2 ? -1 : serial1 > serial2;
+}
+
+// Gives a new proxy its shape. Templates are shared between proxies,
+// so this runs on one thread before the parallel updates.
+static void proxy_attach(broadphase_t *broadphase, proxy_t *proxy) {
+    proxy->shape = template_acquire(broadphase, proxy->body);
+    proxy->points = vertex_array_init(proxy->shape->points->size);
+    proxy->fresh = true;
+}
+
+// Updates a proxy's box when its body moved or turned. A pure translation
+// only offsets the template's box; vertices wait until proxy_world_points().
+// Only touches the proxy itself, so proxies update in parallel.
+static void proxy_update(proxy_t *proxy) {
+    if (proxy->fresh) {
+        proxy->fresh = false;
+        proxy->dirty = true;
+    } else {
+        vector_t centroid = body_get_centroid(proxy->body);
+        double rotation = body_get_rotation(proxy->body);
+        proxy->dirty = centroid.x != proxy->centroid.x || centroid.y != proxy->centroid.y ||
+                       rotation != proxy->rotation;
+        if (!proxy->dirty) {
+            return;
+        }
+    }
+    proxy->centroid = body_get_centroid(proxy->body);
+    proxy->rotation = body_get_rotation(proxy->body);
+    proxy->world_valid = false;
+
+    shape_template_t *shape = proxy->shape;
+    if (proxy->rotation == shape->rotation) {
+        proxy->normals = shape->normals;
+        proxy->min_x = shape->min_x + proxy->centroid.x;
+        proxy->min_y = shape->min_y + proxy->centroid.y;
+        proxy->max_x = shape->max_x + proxy->centroid.x;
+        proxy->max_y = shape->max_y + proxy->centroid.y;
+        return;
+    }
+
+    // Rotated bodies need their vertices for the box anyway
+    if (proxy->rotated_normals == NULL) {
+        proxy->rotated_normals = vertex_array_init(shape->points->size);
+    }
+    double angle = proxy->rotation - shape->rotation;
+    double c = cos(angle);
+    double s = sin(angle);
+    proxy->min_x = INFINITY;
+    proxy->min_y = INFINITY;
+    proxy->max_x = -INFINITY;
+    proxy->max_y = -INFINITY;
+    for (size_t i = 0; i < shape->points->size; i++) {
+        vector_t local = shape->points->points[i];
+        vector_t point = {.x = local.x * c - local.y * s + proxy->centroid.x,
+                          .y = local.x * s + local.y * c + proxy->centroid.y};
+        vector_t normal = shape->normals->points[i];
+        proxy->points->points[i] = point;
+        proxy->rotated_normals->points[i] = (vector_t){.x = normal.x * c - normal.y * s,
+                                               .y = normal.x * s + normal.y * c};
+        proxy->min_x = fmin(proxy->min_x, point.x);
+        proxy->min_y = fmin(proxy->min_y, point.y);
+        proxy->max_x = fmax(proxy->max_x, point.x);
+        proxy->max_y = fmax(proxy->max_y, point.y);
+    }
+    proxy->normals = proxy->rotated_normals;
+    proxy->world_valid = true;
+}
+
+// Translates the template's vertices into the proxy's buffer if needed
+static void proxy_world_points(proxy_t *proxy) {
+    if (proxy->world_valid) {
+        return;
+    }
+    shape_template_t *shape = proxy->shape;
+    const vector_t *local = shape->points->points;
+    vector_t *world = proxy->points->points;
+    for (size_t i = 0; i < shape->points->size; i++) {
+        world[i] = (vector_t){.x = local[i].x + proxy->centroid.x, .y = local[i].y + proxy->centroid.y};
+    }
+    proxy->world_valid = true;
+}
+
+static void proxy_project(proxy_t *proxy, vector_t axis, double *min, double *max) {
+    *min = INFINITY;
+    *max = -INFINITY;
+    const vector_t *points = proxy->points->points;
+    for (size_t i = 0; i < proxy->points->size; i++) {
+        double projection = vec_dot(points[i], axis);
+        if (projection > *max) {
+            *max = projection;
+        }
+        if (projection < *min) {
+            *min = projection;
+        }
+    }
+}
+
+// Separating axis test over first's edge normals, following the same steps
+// as find_collision()'s helper so handlers see the same axes.
+static bool proxy_separated(proxy_t *first, proxy_t *second, vector_t *axis, double *least_overlap) {
+    *axis = VEC_ZERO;
+    *least_overlap = INFINITY;
+    for (size_t i = 0; i < first->normals->size; i++) {
+        vector_t normal = first->normals->points[i];
+        double min1, max1, min2, max2;
+        proxy_project(first, normal, &min1, &max1);
+        proxy_project(second, normal, &min2, &max2);
+        if ((min1 < min2 && max1 < min2) || (min2 < min1 && max2 < min1)) {
+            return true;
+        }
+        double overlap = INFINITY;
+        if (min1 < min2) {
+            overlap = max1 - min2;
+        } else if (min2 < min1) {
+            overlap = max2 - min1;
+        }
+        if (overlap < *least_overlap) {
+            *least_overlap = overlap;
+            *axis = normal;
+        }
+    }
+    return false;
+}
+
+// Both proxies' world vertices must be up to date
+static bool proxy_collide(proxy_t *proxy1, proxy_t *proxy2, vector_t *axis) {
+    vector_t axis1, axis2;
+    double overlap1, overlap2;
+    if (proxy_separated(proxy1, proxy2, &axis1, &overlap1) ||
+        proxy_separated(proxy2, proxy1, &axis2, &overlap2)) {
+        return false;
+    }
+    *axis = overlap1 < overlap2 ? axis1 : axis2;
+    return true;
+}
+
+static void update_proxies(void *aux, size_t start, size_t end, size_t chunk) {
+    broadphase_t *broadphase = aux;
+    for (size_t i = start; i < end; i++) {
+        if (broadphase->proxies[i].body != NULL) {
+            proxy_update(&broadphase->proxies[i]);
+        }
+    }
+}
+
+static void prepare_proxies(void *aux, size_t start, size_t end, size_t chunk) {
+    broadphase_t *broadphase = aux;
+    for (size_t i = start; i < end; i++) {
+        proxy_t *proxy = &broadphase->proxies[i];
+        if (proxy->needed) {
+            proxy_world_points(proxy);
+            proxy->needed = false;
+        }
+    }
+}
+
+static void run_checks(void *aux, size_t start, size_t end, size_t chunk) {
+    broadphase_t *broadphase = aux;
+    for (size_t i = start; i < end; i++) {
+        check_t *check = &broadphase->checks[i];
+        pair_t *pair = check->pair;
+        check->collided = proxy_collide(&broadphase->proxies[pair->proxy1],
+                                        &broadphase->proxies[pair->proxy2], &check->axis);
+    }
+}
+
+static perf_counter_t *sat_tests_counter = NULL;
+static perf_counter_t *pairs_counter = NULL;
+
+static void broadphase_tick(void *aux) {
+    PROFILE_ZONE("broadphase_tick");
+    broadphase_t *broadphase = aux;
+    broadphase_prune(broadphase);
+
+    size_t num_proxies = broadphase->num_proxies;
+    size_t num_pairs = broadphase->num_pairs;
+    broadphase->stats = (broadphase_stats_t){.bodies = broadphase->num_live_proxies, .pairs = num_pairs};
+
+    for (size_t i = 0; i < num_proxies; i++) {
+        if (broadphase->proxies[i].body != NULL && broadphase->proxies[i].shape == NULL) {
+            proxy_attach(broadphase, &broadphase->proxies[i]);
+        }
+    }
+    parallel_for(num_proxies, BROADPHASE_PROXY_GRAIN, update_proxies, broadphase);
+
+    broadphase->num_candidates = 0;
+    if (broadphase->kind == BROADPHASE_UNIFORM_GRID) {
+        find_pairs_grid(broadphase);
+    } else {
+        find_pairs_sweep(broadphase);
+    }
+    broadphase->stats.candidates = broadphase->num_candidates;
+
+    // Gather the registered pairs among the candidates, in registration order
+    broadphase->num_tests = 0;
+    for (size_t i = 0; i < broadphase->num_candidates; i++) {
+        candidate_t *candidate = &broadphase->candidates[i];
+        pair_slot_t *slot = &broadphase->pair_slots[pair_slot_find(broadphase, candidate->proxy1,
+                                                                   candidate->proxy2)];
+        for (pair_t *pair = slot->head; pair != NULL; pair = pair->next) {
+            if (pair->removed) {
+                continue;
+            }
+            broadphase->tests = array_grow(broadphase->tests, &broadphase->test_capacity,
+                                           broadphase->num_tests + 1, sizeof(pair_t *));
+            broadphase->tests[broadphase->num_tests++] = pair;
+        }
+    }
+    qsort(broadphase->tests, broadphase->num_tests, sizeof(pair_t *), compare_serials);
+
+    for (size_t i = 0; i < num_pairs; i++) {
+        broadphase->live[i]->tested_before = broadphase->live[i]->tested;
+        broadphase->live[i]->tested = false;
+    }
+
+    PROFILE_ZONE("narrowphase");
+    // Pick the pairs whose result may have changed and the proxies they need
+    broadphase->num_checks = 0;
+    for (size_t i = 0; i < broadphase->num_tests; i++) {
+        pair_t *pair = broadphase->tests[i];
+        proxy_t *proxy1 = &broadphase->proxies[pair->proxy1];
+        proxy_t *proxy2 = &broadphase->proxies[pair->proxy2];
+        pair->tested = true;
+
+        // Neither body moved since the last test, so the answer is the same
+        if (pair->tested_before && !proxy1->dirty && !proxy2->dirty) {
+            broadphase->stats.reused++;
+            if (pair->collided) {
+                broadphase->stats.contacts++;
+            }
+            continue;
+        }
+        proxy1->needed = true;
+        proxy2->needed = true;
+        broadphase->checks = array_grow(broadphase->checks, &broadphase->check_capacity,
+                                        broadphase->num_checks + 1, sizeof(check_t));
+        broadphase->checks[broadphase->num_checks++] = (check_t){.pair = pair};
+    }
+
+    // Each chunk writes only its own proxies' vertices, then its own checks
+    parallel_for(num_proxies, BROADPHASE_PROXY_GRAIN, prepare_proxies, broadphase);
+    parallel_for(broadphase->num_checks, BROADPHASE_CHECK_GRAIN, run_checks, broadphase);
+
+    // Handlers run on this thread in registration order, as if the tests had
+    // run one by one. Pairs dropped by an earlier handler stay silent.
+    for (size_t i = 0; i < broadphase->num_checks; i++) {
+        check_t *check = &broadphase->checks[i];
+        pair_t *pair = check->pair;
+        if (pair->removed) {
+            continue;
+        }
+        bool started = check->collided && !pair->collided;
+        pair->collided = check->collided;
+        broadphase->stats.tests++;
+        if (check->collided) {
+            broadphase->stats.contacts++;
+        }
+        if (started) {
+            pair->handler(broadphase->proxies[pair->proxy1].body,
+                          broadphase->proxies[pair->proxy2].body, check->axis, pair->aux);
+        }
+    }
+    for (size_t i = 0; i < num_pairs; i++) {
+        if (!broadphase->live[i]->tested) {
+            broadphase->live[i]->collided = false;
+        }
+    }
+
+    if (sat_tests_counter == NULL) {
+        sat_tests_counter = perf_counter_register("SAT tests/tick", false);
+        pairs_counter = perf_counter_register("collision pairs", false);
+    }
+    perf_counter_set(sat_tests_counter, broadphase->stats.tests);
+    perf_counter_set(pairs_counter, num_pairs);
+
+    // Drop what this tick's handlers and earlier force creators removed
+    // while the scene still holds it
+    broadphase_prune(broadphase);
+}
+
+static void broadphase_free(void *aux) {
+    broadphase_t *broadphase = aux;
+    for (size_t i = 0; i < broadphase->num_pairs; i++) {
+        if (broadphase->live[i]->freer != NULL) {
+            broadphase->live[i]->freer(broadphase->live[i]->aux);
+        }
+    }
+    for (size_t i = 0; i < broadphase->num_proxies; i++) {
+        if (broadphase->proxies[i].body != NULL) {
+            proxy_release(broadphase, &broadphase->proxies[i]);
+        }
+    }
+    pool_free(broadphase->pair_pool);
+    free(broadphase->templates);
+    free(broadphase->proxies);
+    free(broadphase->free_proxies);
+    free(broadphase->order);
+    free(broadphase->live);
+    free(broadphase->dead_pairs);
+    ptr_map_free(broadphase->body_proxies);
+    free(broadphase->pair_slots);
+    free(broadphase->candidates);
+    free(broadphase->grid);
+    free(broadphase->tests);
+    free(broadphase->checks);
+    free(broadphase);
+}
+
+broadphase_t *broadphase_init(scene_t *scene, broadphase_kind_t kind, double cell_size) {
+    broadphase_t *broadphase = calloc(1, sizeof(broadphase_t));
+    assert(broadphase != NULL);
+    broadphase->scene = scene;
+    broadphase_set_kind(broadphase, kind, cell_size);
+    broadphase->pair_pool = pool_init(sizeof(pair_t), BROADPHASE_PAIR_CHUNK, "collision pair pool");
+    broadphase->body_proxies = ptr_map_init(BROADPHASE_INITIAL_SIZE);
+    rebuild_pair_slots(broadphase, 1);
+
+    scene_add_force_creator(scene, broadphase_tick, broadphase, broadphase_free);
+    return broadphase;
+}
+
+void broadphase_add_collision(broadphase_t *broadphase, body_t *body1, body_t *body2,
+                              collision_handler_t handler, void *aux, free_func_t freer) {
+    assert(body1 != body2);
+    size_t proxy1 = proxy_for(broadphase, body1);
+    size_t proxy2 = proxy_for(broadphase, body2);
+
+    pair_t *pair = pool_alloc(broadphase->pair_pool);
+    *pair = (pair_t){
+        .proxy1 = proxy1,
+        .proxy2 = proxy2,
+        .handler = handler,
+        .aux = aux,
+        .freer = freer,
+        .serial = broadphase->next_serial++,
+        .live_index = broadphase->num_pairs,
+        .collided = false,
+        .tested = false,
+        .tested_before = false,
+        .removed = false,
+        .next = NULL,
+    };
+    broadphase->live = array_grow(broadphase->live, &broadphase->live_capacity,
+                                  broadphase->num_pairs + 1, sizeof(pair_t *));
+    broadphase->live[broadphase->num_pairs++] = pair;
+    proxy_link(broadphase, proxy1, pair);
+    proxy_link(broadphase, proxy2, pair);
+
+    if ((broadphase->num_pair_keys + 1) * 2 > broadphase->pair_slot_capacity) {
+        rebuild_pair_slots(broadphase, broadphase->num_pair_keys + 1);
+    } else {
+        pair_slot_insert(broadphase, pair);
+    }
+}
+
+void broadphase_remove_collisions(broadphase_t *broadphase, body_t *body1, body_t *body2) {
+    size_t proxy1;
+    size_t proxy2;
+    if (!ptr_map_get(broadphase->body_proxies, body1, &proxy1) ||
+        !ptr_map_get(broadphase->body_proxies, body2, &proxy2)) {
+        return;
+    }
+    size_t lo = proxy1 < proxy2 ? proxy1 : proxy2;
+    size_t hi = proxy1 < proxy2 ? proxy2 : proxy1;
+    pair_slot_t *slot = &broadphase->pair_slots[pair_slot_find(broadphase, lo, hi)];
+    for (pair_t *pair = slot->head; pair != NULL; pair = pair->next) {
+        if (!pair->removed) {
+            pair->removed = true;
+            broadphase->dead_pairs = array_grow(broadphase->dead_pairs,
+                                                &broadphase->dead_pair_capacity,
+                                                broadphase->num_dead_pairs + 1, sizeof(pair_t *));
+            broadphase->dead_pairs[broadphase->num_dead_pairs++] = pair;
+        }
+    }
+}
+
+void broadphase_set_kind(broadphase_t *broadphase, broadphase_kind_t kind, double cell_size) {
+    assert(kind == BROADPHASE_SWEEP_AND_PRUNE || cell_size > 0);
+    broadphase->kind = kind;
+    broadphase->cell_size = cell_size;
+}
+
+broadphase_stats_t broadphase_get_stats(broadphase_t *broadphase) {
+    return broadphase->stats;
+}
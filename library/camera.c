@@ -0,0 +1,22 @@
+#include "camera.h"
+#include <assert.h>
+
+static camera_t camera = {.position = {.x = 0, .y = 0}, .zoom = 1.0};
+
+camera_t camera_get(void) {
+    return camera;
+}
+
+void camera_set_position(vector_t position) {
+    camera.position = position;
+}
+
+void camera_set_zoom(double zoom) {
+    assert(zoom > 0);
+    camera.zoom = zoom;
+}
+
+void camera_reset(void) {
+    camera.position = VEC_ZERO;
+    camera.zoom = 1.0;
+}
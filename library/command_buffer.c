@@ -0,0 +1,146 @@
+#include "command_buffer.h"
+#include "perf_counters.h"
+#include <assert.h>
+#include <stdlib.h>
+
+const size_t COMMAND_BUFFER_INITIAL_SIZE = 16;
+
+typedef enum command_kind {
+    COMMAND_ADD_BODY,
+    COMMAND_REMOVE_BODY,
+    COMMAND_ADD_FORCE_CREATOR,
+    COMMAND_ADD_COLLISION,
+    COMMAND_REMOVE_COLLISIONS
+} command_kind_t;
+
+typedef struct command {
+    command_kind_t kind;
+    body_t *body1;
+    body_t *body2;
+    broadphase_t *broadphase;
+    force_creator_t forcer;
+    collision_handler_t handler;
+    void *aux;
+    list_t *bodies;
+    free_func_t freer;
+} command_t;
+
+typedef struct command_buffer {
+    scene_t *scene;
+    command_t *commands;
+    size_t size;
+    size_t capacity;
+} command_buffer_t;
+
+static perf_counter_t *applied_counter = NULL;
+
+static void push(command_buffer_t *buffer, command_t command) {
+    if (buffer->size == buffer->capacity) {
+        buffer->capacity = buffer->capacity > 0 ? buffer->capacity * 2 : COMMAND_BUFFER_INITIAL_SIZE;
+        buffer->commands = realloc(buffer->commands, buffer->capacity * sizeof(command_t));
+        assert(buffer->commands != NULL);
+    }
+    buffer->commands[buffer->size++] = command;
+}
+
+command_buffer_t *command_buffer_init(scene_t *scene) {
+    command_buffer_t *buffer = malloc(sizeof(command_buffer_t));
+    assert(buffer != NULL);
+    buffer->scene = scene;
+    buffer->commands = NULL;
+    buffer->size = 0;
+    buffer->capacity = 0;
+    return buffer;
+}
+
+void command_buffer_free(command_buffer_t *buffer) {
+    for (size_t i = 0; i < buffer->size; i++) {
+        command_t *command = &buffer->commands[i];
+        switch (command->kind) {
+        case COMMAND_ADD_BODY:
+            body_free(command->body1);
+            break;
+        case COMMAND_ADD_FORCE_CREATOR:
+            if (command->bodies != NULL) {
+                list_free(command->bodies);
+            }
+            // Fall through to free aux
+        case COMMAND_ADD_COLLISION:
+            if (command->freer != NULL) {
+                command->freer(command->aux);
+            }
+            break;
+        default:
+            break;
+        }
+    }
+    free(buffer->commands);
+    free(buffer);
+}
+
+void command_buffer_add_body(command_buffer_t *buffer, body_t *body) {
+    push(buffer, (command_t){.kind = COMMAND_ADD_BODY, .body1 = body});
+}
+
+void command_buffer_remove_body(command_buffer_t *buffer, body_t *body) {
+    push(buffer, (command_t){.kind = COMMAND_REMOVE_BODY, .body1 = body});
+}
+
+void command_buffer_add_force_creator(command_buffer_t *buffer, force_creator_t forcer,
+                                      void *aux, list_t *bodies, free_func_t freer) {
+    push(buffer, (command_t){.kind = COMMAND_ADD_FORCE_CREATOR, .forcer = forcer, .aux = aux,
+                             .bodies = bodies, .freer = freer});
+}
+
+void command_buffer_add_collision(command_buffer_t *buffer, broadphase_t *broadphase,
+                                  body_t *body1, body_t *body2, collision_handler_t handler,
+                                  void *aux, free_func_t freer) {
+    push(buffer, (command_t){.kind = COMMAND_ADD_COLLISION, .broadphase = broadphase,
+                             .body1 = body1, .body2 = body2, .handler = handler, .aux = aux,
+                             .freer = freer});
+}
+
+void command_buffer_remove_collisions(command_buffer_t *buffer, broadphase_t *broadphase,
+                                      body_t *body1, body_t *body2) {
+    push(buffer, (command_t){.kind = COMMAND_REMOVE_COLLISIONS, .broadphase = broadphase,
+                             .body1 = body1, .body2 = body2});
+}
+
+void command_buffer_apply(command_buffer_t *buffer) {
+    for (size_t i = 0; i < buffer->size; i++) {
+        command_t command = buffer->commands[i];
+        switch (command.kind) {
+        case COMMAND_ADD_BODY:
+            scene_add_body(buffer->scene, command.body1);
+            break;
+        case COMMAND_REMOVE_BODY:
+            body_remove(command.body1);
+            break;
+        case COMMAND_ADD_FORCE_CREATOR:
+            if (command.bodies != NULL) {
+                scene_add_bodies_force_creator(buffer->scene, command.forcer, command.aux,
+                                               command.bodies, command.freer);
+            } else {
+                scene_add_force_creator(buffer->scene, command.forcer, command.aux, command.freer);
+            }
+            break;
+        case COMMAND_ADD_COLLISION:
+            broadphase_add_collision(command.broadphase, command.body1, command.body2,
+                                     command.handler, command.aux, command.freer);
+            break;
+        case COMMAND_REMOVE_COLLISIONS:
+            broadphase_remove_collisions(command.broadphase, command.body1, command.body2);
+            break;
+        }
+    }
+
+    if (applied_counter == NULL) {
+        applied_counter = perf_counter_register("deferred commands", true);
+    }
+    perf_counter_add(applied_counter, buffer->size);
+    buffer->size = 0;
+}
+
+size_t command_buffer_size(command_buffer_t *buffer) {
+    return buffer->size;
+}
@@ -0,0 +1,197 @@
+#include "fixed_step.h"
+#include "list.h"
+#include "ptr_map.h"
+#include "vertex_array.h"
+#include <assert.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+const size_t FIXED_STEP_INITIAL_SIZE = 64;
+
+// Saved state of one body. The shape is copied out of the body the first
+// time it is drawn, relative to the centroid and unrotated, and kept until
+// the body leaves the scene.
+typedef struct saved_body {
+    body_t *body;
+    vector_t centroid;
+    double rotation;
+    // False until fixed_step_save() sees the body
+    bool saved;
+    vertex_array_t *shape;
+} saved_body_t;
+
+typedef struct fixed_step {
+    double dt;
+    size_t max_steps;
+    double accumulator;
+    saved_body_t *saved;
+    size_t num_saved;
+    size_t saved_capacity;
+    // The array fixed_step_save() rebuilds into
+    saved_body_t *spare;
+    size_t spare_capacity;
+    // Each body's index in saved
+    ptr_map_t *indices;
+} fixed_step_t;
+
+static saved_body_t *saved_find(fixed_step_t *stepper, body_t *body) {
+    size_t index;
+    if (!ptr_map_get(stepper->indices, body, &index)) {
+        return NULL;
+    }
+    return &stepper->saved[index];
+}
+
+fixed_step_t *fixed_step_init(double dt, size_t max_steps) {
+    assert(dt > 0.0);
+    fixed_step_t *stepper = malloc(sizeof(fixed_step_t));
+    assert(stepper != NULL);
+    stepper->dt = dt;
+    stepper->max_steps = max_steps;
+    stepper->accumulator = 0.0;
+    stepper->saved = NULL;
+    stepper->num_saved = 0;
+    stepper->saved_capacity = 0;
+    stepper->spare = NULL;
+    stepper->spare_capacity = 0;
+    stepper->indices = ptr_map_init(FIXED_STEP_INITIAL_SIZE);
+    return stepper;
+}
+
+void fixed_step_free(fixed_step_t *stepper) {
+    for (size_t i = 0; i < stepper->num_saved; i++) {
+        if (stepper->saved[i].shape != NULL) {
+            vertex_array_free(stepper->saved[i].shape);
+        }
+    }
+    free(stepper->saved);
+    free(stepper->spare);
+    ptr_map_free(stepper->indices);
+    free(stepper);
+}
+
+size_t fixed_step_advance(fixed_step_t *stepper, double frame_dt) {
+    stepper->accumulator += frame_dt;
+    size_t steps = (size_t)(stepper->accumulator / stepper->dt);
+    if (steps > stepper->max_steps) {
+        steps = stepper->max_steps;
+        // Drop the backlog but keep the fraction, so drawing stays smooth
+        stepper->accumulator = fmod(stepper->accumulator, stepper->dt) + steps * stepper->dt;
+    }
+    stepper->accumulator -= steps * stepper->dt;
+    return steps;
+}
+
+double fixed_step_get_dt(fixed_step_t *stepper) {
+    return stepper->dt;
+}
+
+double fixed_step_get_alpha(fixed_step_t *stepper) {
+    double alpha = stepper->accumulator / stepper->dt;
+    return alpha < 1.0 ? alpha : 1.0;
+}
+
+void fixed_step_save(fixed_step_t *stepper, scene_t *scene) {
+    size_t body_count = scene_bodies(scene);
+    stepper->spare = array_grow(stepper->spare, &stepper->spare_capacity, body_count,
+                                sizeof(saved_body_t));
+    for (size_t i = 0; i < body_count; i++) {
+        body_t *body = scene_get_body(scene, i);
+        saved_body_t *old = saved_find(stepper, body);
+        stepper->spare[i] = (saved_body_t){.body = body,
+                                           .centroid = body_get_centroid(body),
+                                           .rotation = body_get_rotation(body),
+                                           .saved = true,
+                                           .shape = old != NULL ? old->shape : NULL};
+        if (old != NULL) {
+            old->shape = NULL;
+        }
+    }
+
+    // Shapes not carried over belong to bodies the scene has freed
+    for (size_t i = 0; i < stepper->num_saved; i++) {
+        if (stepper->saved[i].shape != NULL) {
+            vertex_array_free(stepper->saved[i].shape);
+        }
+    }
+    saved_body_t *saved = stepper->saved;
+    size_t capacity = stepper->saved_capacity;
+    stepper->saved = stepper->spare;
+    stepper->saved_capacity = stepper->spare_capacity;
+    stepper->spare = saved;
+    stepper->spare_capacity = capacity;
+    stepper->num_saved = body_count;
+
+    ptr_map_clear(stepper->indices);
+    for (size_t i = 0; i < body_count; i++) {
+        ptr_map_put(stepper->indices, stepper->saved[i].body, i);
+    }
+}
+
+// Finds a body's entry, adding an unsaved one for a body new since the last save
+static saved_body_t *saved_claim(fixed_step_t *stepper, body_t *body) {
+    saved_body_t *entry = saved_find(stepper, body);
+    if (entry != NULL) {
+        return entry;
+    }
+    size_t index = stepper->num_saved++;
+    stepper->saved = array_grow(stepper->saved, &stepper->saved_capacity, stepper->num_saved,
+                                sizeof(saved_body_t));
+    stepper->saved[index] = (saved_body_t){.body = body, .saved = false, .shape = NULL};
+    ptr_map_put(stepper->indices, body, index);
+    return &stepper->saved[index];
+}
+
+// Copies a body's shape relative to its centroid, undoing its rotation
+static vertex_array_t *local_shape(body_t *body) {
+    list_t *list = body_get_shape(body);
+    vertex_array_t *shape = vertex_array_from_list(list);
+    list_free(list);
+    vector_t centroid = body_get_centroid(body);
+    double rotation = body_get_rotation(body);
+    for (size_t i = 0; i < shape->size; i++) {
+        shape->points[i] = vec_rotate(vec_subtract(shape->points[i], centroid), -rotation);
+    }
+    return shape;
+}
+
+// Finds how far back from its current state a body should be drawn
+static bool interpolation_offset(fixed_step_t *stepper, saved_body_t *entry,
+                                 vector_t *translation, double *rotation) {
+    if (entry == NULL || !entry->saved) {
+        return false;
+    }
+    double back = fixed_step_get_alpha(stepper) - 1.0;
+    *translation = vec_multiply(back, vec_subtract(body_get_centroid(entry->body), entry->centroid));
+    *rotation = back * (body_get_rotation(entry->body) - entry->rotation);
+    return true;
+}
+
+vector_t fixed_step_centroid(fixed_step_t *stepper, body_t *body) {
+    vector_t translation;
+    double rotation;
+    if (!interpolation_offset(stepper, saved_find(stepper, body), &translation, &rotation)) {
+        return body_get_centroid(body);
+    }
+    return vec_add(body_get_centroid(body), translation);
+}
+
+void fixed_step_add_scene(fixed_step_t *stepper, render_batch_t *batch, scene_t *scene) {
+    size_t body_count = scene_bodies(scene);
+    for (size_t i = 0; i < body_count; i++) {
+        body_t *body = scene_get_body(scene, i);
+        if (body_is_removed(body)) {
+            continue;
+        }
+        saved_body_t *entry = saved_claim(stepper, body);
+        if (entry->shape == NULL) {
+            entry->shape = local_shape(body);
+        }
+        vector_t translation = VEC_ZERO;
+        double rotation = 0.0;
+        interpolation_offset(stepper, entry, &translation, &rotation);
+        render_batch_add_shape(batch, entry->shape, vec_add(body_get_centroid(body), translation),
+                               body_get_rotation(body) + rotation, body_get_color(body));
+    }
+}
@@ -0,0 +1,352 @@
+#include "force_batch.h"
+#include "frame_alloc.h"
+#include "parallel.h"
+#include "perf_counters.h"
+#include "profile.h"
+#include "ptr_map.h"
+#include "vector.h"
+#include <assert.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+const size_t FORCE_BATCH_INITIAL_SIZE = 16;
+// Iterations per parallel_for() chunk; small batches run on one thread
+const size_t FORCE_BATCH_GRAIN = 512;
+// Gravity between closer centroids is skipped so it stays finite
+const double FORCE_BATCH_MIN_GRAVITY_DISTANCE = 5;
+// Marks a dropped body while compacting
+const size_t FORCE_BATCH_NONE = SIZE_MAX;
+
+// Gravity or a spring between two bodies, by index into the batch's bodies
+typedef struct pair_term {
+    size_t body1;
+    size_t body2;
+    double constant;
+} pair_term_t;
+
+typedef struct drag_term {
+    size_t body;
+    double gamma;
+} drag_term_t;
+
+// What the kernels read from a body, gathered once per tick
+typedef struct body_state {
+    vector_t centroid;
+    vector_t velocity;
+    double mass;
+} body_state_t;
+
+typedef struct force_batch {
+    scene_t *scene;
+    body_t **bodies;
+    size_t num_bodies;
+    size_t body_capacity;
+    // Each body's index
+    ptr_map_t *indices;
+    // Set by the prune for bodies found in the scene, by index
+    bool *in_scene;
+    size_t in_scene_capacity;
+
+    pair_term_t *gravity;
+    size_t num_gravity;
+    size_t gravity_capacity;
+    pair_term_t *springs;
+    size_t num_springs;
+    size_t spring_capacity;
+    drag_term_t *drag;
+    size_t num_drag;
+    size_t drag_capacity;
+
+    // Scratch space reused every tick: body states and summed forces per
+    // body, and each term's force
+    body_state_t *states;
+    vector_t *totals;
+    size_t state_capacity;
+    vector_t *gravity_forces;
+    size_t gravity_force_capacity;
+    vector_t *spring_forces;
+    size_t spring_force_capacity;
+    vector_t *drag_forces;
+    size_t drag_force_capacity;
+
+    force_batch_stats_t stats;
+} force_batch_t;
+
+// Gives each body its position in the compacted array
+static void rebuild_indices(force_batch_t *batch) {
+    ptr_map_clear(batch->indices);
+    for (size_t i = 0; i < batch->num_bodies; i++) {
+        ptr_map_put(batch->indices, batch->bodies[i], i);
+    }
+}
+
+static size_t body_index(force_batch_t *batch, body_t *body) {
+    size_t index;
+    if (ptr_map_get(batch->indices, body, &index)) {
+        return index;
+    }
+    index = batch->num_bodies;
+    batch->bodies = array_grow(batch->bodies, &batch->body_capacity, index + 1, sizeof(body_t *));
+    batch->bodies[batch->num_bodies++] = body;
+    ptr_map_put(batch->indices, body, index);
+    return index;
+}
+
+static size_t prune_pair_terms(pair_term_t *terms, size_t count, size_t *remap) {
+    size_t kept = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (remap[terms[i].body1] != FORCE_BATCH_NONE && remap[terms[i].body2] != FORCE_BATCH_NONE) {
+            terms[kept++] = terms[i];
+        }
+    }
+    return kept;
+}
+
+// Drops terms acting on bodies that were removed or are gone from the
+// scene, then bodies no term acts on. Bodies are only read once found in
+// the scene, so one freed since the last prune is dropped without being
+// touched. remap holds FORCE_BATCH_NONE for dropped bodies and 1 for used
+// ones until the survivors get their new indices.
+static void force_batch_prune(force_batch_t *batch) {
+    batch->in_scene = array_grow(batch->in_scene, &batch->in_scene_capacity, batch->num_bodies,
+                                 sizeof(bool));
+    for (size_t i = 0; i < batch->num_bodies; i++) {
+        batch->in_scene[i] = false;
+    }
+    size_t body_count = scene_bodies(batch->scene);
+    for (size_t i = 0; i < body_count; i++) {
+        body_t *body = scene_get_body(batch->scene, i);
+        size_t index;
+        if (ptr_map_get(batch->indices, body, &index) && !body_is_removed(body)) {
+            batch->in_scene[index] = true;
+        }
+    }
+
+    size_t *remap = NULL;
+    for (size_t i = 0; i < batch->num_bodies; i++) {
+        if (!batch->in_scene[i]) {
+            if (remap == NULL) {
+                remap = frame_alloc(batch->num_bodies * sizeof(size_t));
+                for (size_t j = 0; j < batch->num_bodies; j++) {
+                    remap[j] = 0;
+                }
+            }
+            remap[i] = FORCE_BATCH_NONE;
+        }
+    }
+    if (remap == NULL) {
+        return;
+    }
+
+    batch->num_gravity = prune_pair_terms(batch->gravity, batch->num_gravity, remap);
+    batch->num_springs = prune_pair_terms(batch->springs, batch->num_springs, remap);
+    size_t kept = 0;
+    for (size_t i = 0; i < batch->num_drag; i++) {
+        if (remap[batch->drag[i].body] != FORCE_BATCH_NONE) {
+            batch->drag[kept++] = batch->drag[i];
+        }
+    }
+    batch->num_drag = kept;
+
+    for (size_t i = 0; i < batch->num_gravity; i++) {
+        remap[batch->gravity[i].body1] = remap[batch->gravity[i].body2] = 1;
+    }
+    for (size_t i = 0; i < batch->num_springs; i++) {
+        remap[batch->springs[i].body1] = remap[batch->springs[i].body2] = 1;
+    }
+    for (size_t i = 0; i < batch->num_drag; i++) {
+        remap[batch->drag[i].body] = 1;
+    }
+    size_t num_bodies = 0;
+    for (size_t i = 0; i < batch->num_bodies; i++) {
+        if (remap[i] == 1) {
+            remap[i] = num_bodies;
+            batch->bodies[num_bodies++] = batch->bodies[i];
+        } else {
+            remap[i] = FORCE_BATCH_NONE;
+        }
+    }
+    batch->num_bodies = num_bodies;
+
+    for (size_t i = 0; i < batch->num_gravity; i++) {
+        batch->gravity[i].body1 = remap[batch->gravity[i].body1];
+        batch->gravity[i].body2 = remap[batch->gravity[i].body2];
+    }
+    for (size_t i = 0; i < batch->num_springs; i++) {
+        batch->springs[i].body1 = remap[batch->springs[i].body1];
+        batch->springs[i].body2 = remap[batch->springs[i].body2];
+    }
+    for (size_t i = 0; i < batch->num_drag; i++) {
+        batch->drag[i].body = remap[batch->drag[i].body];
+    }
+    rebuild_indices(batch);
+}
+
+static void gather_states(void *aux, size_t start, size_t end, size_t chunk) {
+    force_batch_t *batch = aux;
+    for (size_t i = start; i < end; i++) {
+        body_t *body = batch->bodies[i];
+        batch->states[i] = (body_state_t){.centroid = body_get_centroid(body),
+                                          .velocity = body_get_velocity(body),
+                                          .mass = body_get_mass(body)};
+    }
+}
+
+// The kernels do their arithmetic inline rather than through vector.c so
+// the compiler can keep each loop in registers.
+// Each writes the force on body1; body2 gets the opposite.
+static void gravity_kernel(void *aux, size_t start, size_t end, size_t chunk) {
+    force_batch_t *batch = aux;
+    const body_state_t *states = batch->states;
+    const double min_distance_squared = FORCE_BATCH_MIN_GRAVITY_DISTANCE * FORCE_BATCH_MIN_GRAVITY_DISTANCE;
+    for (size_t i = start; i < end; i++) {
+        const pair_term_t *term = &batch->gravity[i];
+        const body_state_t *state1 = &states[term->body1];
+        const body_state_t *state2 = &states[term->body2];
+        double dx = state2->centroid.x - state1->centroid.x;
+        double dy = state2->centroid.y - state1->centroid.y;
+        double distance_squared = dx * dx + dy * dy;
+        double scale = 0;
+        if (distance_squared > min_distance_squared) {
+            scale = term->constant * state1->mass * state2->mass /
+                    (distance_squared * sqrt(distance_squared));
+        }
+        batch->gravity_forces[i] = (vector_t){.x = scale * dx, .y = scale * dy};
+    }
+}
+
+static void spring_kernel(void *aux, size_t start, size_t end, size_t chunk) {
+    force_batch_t *batch = aux;
+    const body_state_t *states = batch->states;
+    for (size_t i = start; i < end; i++) {
+        const pair_term_t *term = &batch->springs[i];
+        vector_t centroid1 = states[term->body1].centroid;
+        vector_t centroid2 = states[term->body2].centroid;
+        batch->spring_forces[i] = (vector_t){.x = term->constant * (centroid2.x - centroid1.x),
+                                             .y = term->constant * (centroid2.y - centroid1.y)};
+    }
+}
+
+static void drag_kernel(void *aux, size_t start, size_t end, size_t chunk) {
+    force_batch_t *batch = aux;
+    const body_state_t *states = batch->states;
+    for (size_t i = start; i < end; i++) {
+        const drag_term_t *term = &batch->drag[i];
+        vector_t velocity = states[term->body].velocity;
+        batch->drag_forces[i] = (vector_t){.x = -term->gamma * velocity.x,
+                                           .y = -term->gamma * velocity.y};
+    }
+}
+
+static void add_pair_forces(vector_t *totals, const pair_term_t *terms, const vector_t *forces,
+                            size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        totals[terms[i].body1].x += forces[i].x;
+        totals[terms[i].body1].y += forces[i].y;
+        totals[terms[i].body2].x -= forces[i].x;
+        totals[terms[i].body2].y -= forces[i].y;
+    }
+}
+
+static perf_counter_t *terms_counter = NULL;
+
+static void force_batch_tick(void *aux) {
+    PROFILE_ZONE("force_batch_tick");
+    force_batch_t *batch = aux;
+    force_batch_prune(batch);
+
+    size_t num_bodies = batch->num_bodies;
+    batch->stats = (force_batch_stats_t){.bodies = num_bodies, .gravity = batch->num_gravity,
+                                         .springs = batch->num_springs, .drag = batch->num_drag};
+
+    size_t state_capacity = batch->state_capacity;
+    batch->states = array_grow(batch->states, &batch->state_capacity, num_bodies,
+                               sizeof(body_state_t));
+    batch->totals = array_grow(batch->totals, &state_capacity, num_bodies, sizeof(vector_t));
+    batch->gravity_forces = array_grow(batch->gravity_forces, &batch->gravity_force_capacity,
+                                       batch->num_gravity, sizeof(vector_t));
+    batch->spring_forces = array_grow(batch->spring_forces, &batch->spring_force_capacity,
+                                      batch->num_springs, sizeof(vector_t));
+    batch->drag_forces = array_grow(batch->drag_forces, &batch->drag_force_capacity,
+                                    batch->num_drag, sizeof(vector_t));
+
+    // Each chunk writes only its own bodies' states, then its own terms' forces
+    parallel_for(num_bodies, FORCE_BATCH_GRAIN, gather_states, batch);
+    parallel_for(batch->num_gravity, FORCE_BATCH_GRAIN, gravity_kernel, batch);
+    parallel_for(batch->num_springs, FORCE_BATCH_GRAIN, spring_kernel, batch);
+    parallel_for(batch->num_drag, FORCE_BATCH_GRAIN, drag_kernel, batch);
+
+    // Sum on this thread in a fixed order, then touch each body once
+    for (size_t i = 0; i < num_bodies; i++) {
+        batch->totals[i] = VEC_ZERO;
+    }
+    add_pair_forces(batch->totals, batch->gravity, batch->gravity_forces, batch->num_gravity);
+    add_pair_forces(batch->totals, batch->springs, batch->spring_forces, batch->num_springs);
+    for (size_t i = 0; i < batch->num_drag; i++) {
+        batch->totals[batch->drag[i].body].x += batch->drag_forces[i].x;
+        batch->totals[batch->drag[i].body].y += batch->drag_forces[i].y;
+    }
+    for (size_t i = 0; i < num_bodies; i++) {
+        body_add_force(batch->bodies[i], batch->totals[i]);
+    }
+
+    if (terms_counter == NULL) {
+        terms_counter = perf_counter_register("batched forces", false);
+    }
+    perf_counter_set(terms_counter, batch->num_gravity + batch->num_springs + batch->num_drag);
+
+    // Drop what earlier force creators removed while the scene still holds it
+    force_batch_prune(batch);
+}
+
+static void force_batch_free(void *aux) {
+    force_batch_t *batch = aux;
+    free(batch->bodies);
+    ptr_map_free(batch->indices);
+    free(batch->in_scene);
+    free(batch->gravity);
+    free(batch->springs);
+    free(batch->drag);
+    free(batch->states);
+    free(batch->totals);
+    free(batch->gravity_forces);
+    free(batch->spring_forces);
+    free(batch->drag_forces);
+    free(batch);
+}
+
+force_batch_t *force_batch_init(scene_t *scene) {
+    force_batch_t *batch = calloc(1, sizeof(force_batch_t));
+    assert(batch != NULL);
+    batch->scene = scene;
+    batch->indices = ptr_map_init(FORCE_BATCH_INITIAL_SIZE);
+
+    scene_add_force_creator(scene, force_batch_tick, batch, force_batch_free);
+    return batch;
+}
+
+void force_batch_add_gravity(force_batch_t *batch, double G, body_t *body1, body_t *body2) {
+    batch->gravity = array_grow(batch->gravity, &batch->gravity_capacity, batch->num_gravity + 1,
+                                sizeof(pair_term_t));
+    batch->gravity[batch->num_gravity++] = (pair_term_t){
+        .body1 = body_index(batch, body1), .body2 = body_index(batch, body2), .constant = G};
+}
+
+void force_batch_add_spring(force_batch_t *batch, double k, body_t *body1, body_t *body2) {
+    batch->springs = array_grow(batch->springs, &batch->spring_capacity, batch->num_springs + 1,
+                                sizeof(pair_term_t));
+    batch->springs[batch->num_springs++] = (pair_term_t){
+        .body1 = body_index(batch, body1), .body2 = body_index(batch, body2), .constant = k};
+}
+
+void force_batch_add_drag(force_batch_t *batch, double gamma, body_t *body) {
+    batch->drag = array_grow(batch->drag, &batch->drag_capacity, batch->num_drag + 1,
+                             sizeof(drag_term_t));
+    batch->drag[batch->num_drag++] = (drag_term_t){.body = body_index(batch, body), .gamma = gamma};
+}
+
+force_batch_stats_t force_batch_get_stats(force_batch_t *batch) {
+    return batch->stats;
+}
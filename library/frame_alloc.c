@@ -0,0 +1,106 @@
+#include "frame_alloc.h"
+#include "perf_counters.h"
+#include <assert.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+const size_t FRAME_ALLOC_CHUNK = 64 * 1024;
+
+typedef struct frame_state {
+    arena_t *arena;
+    size_t number;
+    size_t mallocs;
+    size_t untracked;
+    size_t untracked_depth;
+    bool allow_malloc;
+    frame_stats_t last;
+} frame_state_t;
+
+static _Thread_local frame_state_t frame = {0};
+
+#ifdef FRAME_ALLOC_CHECK
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+
+static void count_malloc(void) {
+    if (frame.untracked_depth > 0) {
+        frame.untracked++;
+    } else {
+        frame.mallocs++;
+    }
+}
+
+void *__wrap_malloc(size_t size) {
+    count_malloc();
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size) {
+    count_malloc();
+    return __real_calloc(count, size);
+}
+#endif
+
+arena_t *frame_arena(void) {
+    if (frame.arena == NULL) {
+        frame.arena = arena_init(FRAME_ALLOC_CHUNK);
+        frame.allow_malloc = true;
+    }
+    return frame.arena;
+}
+
+void *frame_alloc(size_t size) {
+    return arena_alloc(frame_arena(), size);
+}
+
+void frame_begin(void) {
+#ifdef FRAME_ALLOC_CHECK
+    if (frame.number > 0 && frame.mallocs > 0 && !frame.allow_malloc) {
+        fprintf(stderr, "frame %zu called malloc %zu times in steady state\n", frame.number,
+                frame.mallocs);
+        assert(false);
+    }
+    // Only counted when the check wraps malloc, so only shown in the overlay then
+    static perf_counter_t *allocs_counter = NULL;
+    if (allocs_counter == NULL) {
+        allocs_counter = perf_counter_register("allocs last frame", false);
+    }
+    perf_counter_set(allocs_counter, frame.mallocs + frame.untracked);
+#endif
+    frame.last = (frame_stats_t){.mallocs = frame.mallocs, .untracked = frame.untracked};
+    frame.mallocs = 0;
+    frame.untracked = 0;
+    frame.allow_malloc = false;
+    frame.number++;
+
+    if (frame.arena != NULL) {
+        arena_stats_t stats = arena_get_stats(frame.arena);
+        frame.last.scratch_bytes = stats.used;
+        if (stats.chunks > 1) {
+            // The frame outgrew one chunk; make one chunk big enough for it
+            arena_free(frame.arena);
+            frame.arena = arena_init(stats.reserved);
+            frame.allow_malloc = true;
+        } else {
+            arena_reset(frame.arena);
+        }
+    }
+}
+
+void frame_allow_malloc(void) {
+    frame.allow_malloc = true;
+}
+
+void frame_untracked_begin(void) {
+    frame.untracked_depth++;
+}
+
+void frame_untracked_end(void) {
+    assert(frame.untracked_depth > 0);
+    frame.untracked_depth--;
+}
+
+frame_stats_t frame_get_stats(void) {
+    return frame.last;
+}
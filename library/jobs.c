@@ -0,0 +1,329 @@
+#include "jobs.h"
+#include <SDL2/SDL.h>
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Without pthreads, emscripten cannot start threads at all
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+#define JOBS_HAS_THREADS 0
+#else
+#define JOBS_HAS_THREADS 1
+#endif
+
+// Web workers beyond the Makefile's PTHREAD_POOL_SIZE only start once the
+// main thread yields to the browser, which a waiting main thread never does
+#ifdef __EMSCRIPTEN_PTHREADS__
+#define JOBS_DEFAULT_MAX_WORKERS 4
+#else
+#define JOBS_DEFAULT_MAX_WORKERS JOBS_MAX_WORKERS
+#endif
+
+const size_t JOBS_INITIAL_DEQUE_SIZE = 64;
+
+typedef struct queued_job {
+    job_func_t func;
+    void *aux;
+    job_counter_t *counter;
+} queued_job_t;
+
+// Jobs held back until a counter reaches zero
+typedef struct job_waiter {
+    job_t *jobs;
+    size_t count;
+    job_counter_t *counter;
+    struct job_waiter *next;
+} job_waiter_t;
+
+// A ring of jobs; the owner uses the back, thieves the front
+typedef struct job_deque {
+    SDL_SpinLock lock;
+    queued_job_t *jobs;
+    size_t capacity;
+    size_t front;
+    size_t size;
+} job_deque_t;
+
+typedef struct scheduler {
+    bool started;
+    bool configured;
+    size_t workers;
+    SDL_Thread *threads[JOBS_MAX_WORKERS];
+    size_t num_threads;
+    // Deque 0 belongs to the main thread and any thread the scheduler did
+    // not start; worker i owns deque i + 1
+    job_deque_t deques[JOBS_MAX_WORKERS + 1];
+
+    // Queued jobs across every deque, and threads asleep waiting for one
+    SDL_atomic_t pending;
+    SDL_atomic_t sleepers;
+    SDL_mutex *lock;
+    SDL_cond *wake;
+    bool stopping;
+} scheduler_t;
+
+static scheduler_t scheduler = {0};
+
+static _Thread_local size_t thread_deque = 0;
+
+// An atomic read that also orders earlier stores before it
+static int atomic_read(SDL_atomic_t *atomic) {
+    return SDL_AtomicAdd(atomic, 0);
+}
+
+static void wake_sleepers(void) {
+    if (atomic_read(&scheduler.sleepers) > 0) {
+        SDL_LockMutex(scheduler.lock);
+        SDL_CondBroadcast(scheduler.wake);
+        SDL_UnlockMutex(scheduler.lock);
+    }
+}
+
+static void deque_push(job_deque_t *deque, queued_job_t job) {
+    SDL_AtomicLock(&deque->lock);
+    if (deque->size == deque->capacity) {
+        size_t capacity = deque->capacity > 0 ? deque->capacity * 2 : JOBS_INITIAL_DEQUE_SIZE;
+        queued_job_t *jobs = malloc(capacity * sizeof(queued_job_t));
+        assert(jobs != NULL);
+        for (size_t i = 0; i < deque->size; i++) {
+            jobs[i] = deque->jobs[(deque->front + i) % deque->capacity];
+        }
+        free(deque->jobs);
+        deque->jobs = jobs;
+        deque->capacity = capacity;
+        deque->front = 0;
+    }
+    deque->jobs[(deque->front + deque->size) % deque->capacity] = job;
+    deque->size++;
+    SDL_AtomicUnlock(&deque->lock);
+    SDL_AtomicAdd(&scheduler.pending, 1);
+}
+
+static bool deque_pop_back(job_deque_t *deque, queued_job_t *job) {
+    SDL_AtomicLock(&deque->lock);
+    bool found = deque->size > 0;
+    if (found) {
+        deque->size--;
+        *job = deque->jobs[(deque->front + deque->size) % deque->capacity];
+    }
+    SDL_AtomicUnlock(&deque->lock);
+    return found;
+}
+
+static bool deque_steal_front(job_deque_t *deque, queued_job_t *job) {
+    SDL_AtomicLock(&deque->lock);
+    bool found = deque->size > 0;
+    if (found) {
+        *job = deque->jobs[deque->front];
+        deque->front = (deque->front + 1) % deque->capacity;
+        deque->size--;
+    }
+    SDL_AtomicUnlock(&deque->lock);
+    return found;
+}
+
+// Takes the newest job of the thread's own deque, or else steals the
+// oldest job of the next thread that has one
+static bool find_job(queued_job_t *job) {
+    size_t num_deques = scheduler.num_threads + 1;
+    size_t self = thread_deque;
+    if (deque_pop_back(&scheduler.deques[self], job)) {
+        SDL_AtomicAdd(&scheduler.pending, -1);
+        return true;
+    }
+    for (size_t i = 1; i < num_deques; i++) {
+        if (deque_steal_front(&scheduler.deques[(self + i) % num_deques], job)) {
+            SDL_AtomicAdd(&scheduler.pending, -1);
+            return true;
+        }
+    }
+    return false;
+}
+
+static void counter_add(job_counter_t *counter, size_t count) {
+    SDL_AtomicLock(&counter->lock);
+    SDL_AtomicAdd(&counter->value, (int)count);
+    SDL_AtomicUnlock(&counter->lock);
+}
+
+static void submit(const job_t *jobs, size_t count, job_counter_t *counter) {
+    job_deque_t *deque = &scheduler.deques[thread_deque];
+    for (size_t i = 0; i < count; i++) {
+        deque_push(deque, (queued_job_t){.func = jobs[i].func, .aux = jobs[i].aux,
+                                         .counter = counter});
+    }
+    wake_sleepers();
+}
+
+// Counts a job as finished and releases the jobs waiting for the counter.
+// The counter is only touched under its lock, so a thread that sees it
+// reach zero may free it as soon as the lock is dropped.
+static void counter_finish(job_counter_t *counter) {
+    SDL_AtomicLock(&counter->lock);
+    bool done = SDL_AtomicAdd(&counter->value, -1) == 1;
+    job_waiter_t *waiter = done ? counter->waiters : NULL;
+    if (done) {
+        counter->waiters = NULL;
+    }
+    SDL_AtomicUnlock(&counter->lock);
+    if (!done) {
+        return;
+    }
+
+    while (waiter != NULL) {
+        job_waiter_t *next = waiter->next;
+        submit(waiter->jobs, waiter->count, waiter->counter);
+        free(waiter->jobs);
+        free(waiter);
+        waiter = next;
+    }
+    wake_sleepers();
+}
+
+static void run_job(queued_job_t *job) {
+    job->func(job->aux);
+    if (job->counter != NULL) {
+        counter_finish(job->counter);
+    }
+}
+
+// Sleeps until a job is queued or the counter, if any, reaches zero.
+// Returns false once the scheduler is stopping.
+static bool sleep_until(job_counter_t *counter) {
+    SDL_LockMutex(scheduler.lock);
+    SDL_AtomicAdd(&scheduler.sleepers, 1);
+    while (!scheduler.stopping && atomic_read(&scheduler.pending) == 0 &&
+           (counter == NULL || !job_counter_done(counter))) {
+        SDL_CondWait(scheduler.wake, scheduler.lock);
+    }
+    SDL_AtomicAdd(&scheduler.sleepers, -1);
+    bool running = !scheduler.stopping;
+    SDL_UnlockMutex(scheduler.lock);
+    return running;
+}
+
+static int worker_main(void *aux) {
+    thread_deque = (size_t)(uintptr_t)aux;
+    while (true) {
+        queued_job_t job;
+        if (find_job(&job)) {
+            run_job(&job);
+        } else if (!sleep_until(NULL)) {
+            return 0;
+        }
+    }
+}
+
+static void scheduler_stop(void) {
+    if (!scheduler.started) {
+        return;
+    }
+    SDL_LockMutex(scheduler.lock);
+    scheduler.stopping = true;
+    SDL_CondBroadcast(scheduler.wake);
+    SDL_UnlockMutex(scheduler.lock);
+    for (size_t i = 0; i < scheduler.num_threads; i++) {
+        if (scheduler.threads[i] != NULL) {
+            SDL_WaitThread(scheduler.threads[i], NULL);
+        }
+    }
+    scheduler.num_threads = 0;
+    scheduler.stopping = false;
+    scheduler.started = false;
+}
+
+static void scheduler_start(void) {
+    if (scheduler.lock == NULL) {
+        scheduler.lock = SDL_CreateMutex();
+        scheduler.wake = SDL_CreateCond();
+        assert(scheduler.lock != NULL && scheduler.wake != NULL);
+        atexit(scheduler_stop);
+    }
+    // Set before any worker looks for deques to steal from. A worker that
+    // fails to start leaves its deque empty, and the others carry on.
+    scheduler.num_threads = jobs_get_workers();
+    for (size_t i = 0; i < scheduler.num_threads; i++) {
+        scheduler.threads[i] = SDL_CreateThread(worker_main, "job worker", (void *)(uintptr_t)(i + 1));
+    }
+    scheduler.started = true;
+}
+
+void jobs_set_workers(size_t workers) {
+    scheduler_stop();
+    // Jobs already queued on the old workers' deques move to the main thread
+    for (size_t i = 1; i <= JOBS_MAX_WORKERS; i++) {
+        queued_job_t job;
+        while (deque_steal_front(&scheduler.deques[i], &job)) {
+            deque_push(&scheduler.deques[0], job);
+            SDL_AtomicAdd(&scheduler.pending, -1);
+        }
+    }
+    scheduler.workers = JOBS_HAS_THREADS ? (workers < JOBS_MAX_WORKERS ? workers : JOBS_MAX_WORKERS) : 0;
+    scheduler.configured = true;
+}
+
+size_t jobs_get_workers(void) {
+    if (!scheduler.configured) {
+        size_t cpus = (size_t)SDL_GetCPUCount();
+        size_t workers = cpus > 1 ? cpus - 1 : 0;
+        jobs_set_workers(workers < JOBS_DEFAULT_MAX_WORKERS ? workers : JOBS_DEFAULT_MAX_WORKERS);
+    }
+    return scheduler.workers;
+}
+
+void jobs_run(const job_t *jobs, size_t count, job_counter_t *counter) {
+    if (!scheduler.started) {
+        scheduler_start();
+    }
+    if (counter != NULL) {
+        counter_add(counter, count);
+    }
+    submit(jobs, count, counter);
+}
+
+void jobs_run_after(job_counter_t *dependency, const job_t *jobs, size_t count,
+                    job_counter_t *counter) {
+    if (counter != NULL) {
+        counter_add(counter, count);
+    }
+
+    SDL_AtomicLock(&dependency->lock);
+    if (SDL_AtomicGet(&dependency->value) > 0) {
+        job_waiter_t *waiter = malloc(sizeof(job_waiter_t));
+        assert(waiter != NULL);
+        waiter->jobs = malloc(count * sizeof(job_t));
+        assert(waiter->jobs != NULL);
+        memcpy(waiter->jobs, jobs, count * sizeof(job_t));
+        waiter->count = count;
+        waiter->counter = counter;
+        waiter->next = dependency->waiters;
+        dependency->waiters = waiter;
+        SDL_AtomicUnlock(&dependency->lock);
+        return;
+    }
+    SDL_AtomicUnlock(&dependency->lock);
+
+    if (!scheduler.started) {
+        scheduler_start();
+    }
+    submit(jobs, count, counter);
+}
+
+bool job_counter_done(job_counter_t *counter) {
+    SDL_AtomicLock(&counter->lock);
+    bool done = SDL_AtomicGet(&counter->value) == 0;
+    SDL_AtomicUnlock(&counter->lock);
+    return done;
+}
+
+void jobs_wait(job_counter_t *counter) {
+    while (!job_counter_done(counter)) {
+        queued_job_t job;
+        if (find_job(&job)) {
+            run_job(&job);
+        } else {
+            sleep_until(counter);
+        }
+    }
+}
@@ -0,0 +1,109 @@
+#include "layer_cache.h"
+#include <SDL2/SDL.h>
+#include <assert.h>
+#include <stdlib.h>
+
+typedef struct layer_cache {
+    SDL_Renderer *renderer;
+    SDL_Texture *texture;
+    int width;
+    int height;
+    bool valid;
+    // False when the renderer cannot draw into textures
+    bool supported;
+    SDL_Texture *previous_target;
+    layer_cache_stats_t stats;
+} layer_cache_t;
+
+layer_cache_t *layer_cache_init(SDL_Renderer *renderer) {
+    layer_cache_t *layer = malloc(sizeof(layer_cache_t));
+    assert(layer != NULL);
+    layer->renderer = renderer;
+    layer->texture = NULL;
+    layer->width = 0;
+    layer->height = 0;
+    layer->valid = false;
+    layer->supported = SDL_RenderTargetSupported(renderer);
+    layer->previous_target = NULL;
+    layer->stats = (layer_cache_stats_t){0};
+    return layer;
+}
+
+void layer_cache_free(layer_cache_t *layer) {
+    if (layer->texture != NULL) {
+        SDL_DestroyTexture(layer->texture);
+    }
+    free(layer);
+}
+
+void layer_cache_invalidate(layer_cache_t *layer) {
+    layer->valid = false;
+}
+
+// Makes sure the texture matches the window, dropping stale content if not
+static bool ensure_texture(layer_cache_t *layer) {
+    int width = 0;
+    int height = 0;
+    SDL_GetRendererOutputSize(layer->renderer, &width, &height);
+    if (layer->texture != NULL && width == layer->width && height == layer->height) {
+        return true;
+    }
+
+    if (layer->texture != NULL) {
+        SDL_DestroyTexture(layer->texture);
+    }
+    layer->texture = SDL_CreateTexture(layer->renderer, SDL_PIXELFORMAT_RGBA8888,
+                                       SDL_TEXTUREACCESS_TARGET, width, height);
+    if (layer->texture == NULL) {
+        SDL_Log("layer cache: %s; drawing directly\n", SDL_GetError());
+        layer->supported = false;
+        return false;
+    }
+    SDL_SetTextureBlendMode(layer->texture, SDL_BLENDMODE_BLEND);
+    layer->width = width;
+    layer->height = height;
+    layer->valid = false;
+    return true;
+}
+
+bool layer_cache_begin(layer_cache_t *layer) {
+    if (!layer->supported || !ensure_texture(layer)) {
+        return true;
+    }
+    if (layer->valid) {
+        return false;
+    }
+
+    layer->previous_target = SDL_GetRenderTarget(layer->renderer);
+    SDL_SetRenderTarget(layer->renderer, layer->texture);
+
+    // Clear to transparent without disturbing the caller's draw color
+    Uint8 r, g, b, a;
+    SDL_GetRenderDrawColor(layer->renderer, &r, &g, &b, &a);
+    SDL_SetRenderDrawColor(layer->renderer, 0, 0, 0, 0);
+    SDL_RenderClear(layer->renderer);
+    SDL_SetRenderDrawColor(layer->renderer, r, g, b, a);
+    return true;
+}
+
+void layer_cache_end(layer_cache_t *layer) {
+    if (!layer->supported) {
+        return;
+    }
+    SDL_SetRenderTarget(layer->renderer, layer->previous_target);
+    layer->previous_target = NULL;
+    layer->valid = true;
+    layer->stats.renders++;
+}
+
+void layer_cache_draw(layer_cache_t *layer) {
+    if (!layer->supported || layer->texture == NULL) {
+        return;
+    }
+    SDL_RenderCopy(layer->renderer, layer->texture, NULL, NULL);
+    layer->stats.blits++;
+}
+
+layer_cache_stats_t layer_cache_get_stats(layer_cache_t *layer) {
+    return layer->stats;
+}
@@ -0,0 +1,281 @@
+#include "frame_alloc.h"
+#include "parallel.h"
+#include "profile.h"
+#include "sdl_wrapper.h"
+#include "state.h"
+#include <assert.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL2/SDL.h>
+
+/**
+ * Native replacement for emscripten.c's main loop.
+ *
+ * Usage: bin/<game> [--headless] [--frames N] [--dt SECONDS]
+ *                   [--script FILE] [--record FILE] [--trace FILE]
+ *                   [--threads N]
+ *
+ * --headless runs on SDL's dummy video and audio drivers with the software
+ * renderer, so nothing is shown or played and no display is needed.
+ * --dt replaces time_since_last_tick() with a fixed step (the link wraps it),
+ * which headless runs use by default so they are repeatable.
+ * --script feeds key events from a file; --record writes the keys pressed
+ * in a run to a file in the same format, one "<frame> <down|repeat|up> <key>"
+ * per line with SDL key names. Record with --dt to replay a run exactly.
+ * --trace sets where a PROFILE=1 build writes its Chrome trace on exit.
+ * --threads sets how many threads run the simulation's parallel loops
+ * (see parallel.h), 0 for one per job worker. Results do not depend on it.
+ */
+
+const double HEADLESS_DT = 1.0 / 60.0;
+
+typedef enum { INPUT_DOWN, INPUT_REPEAT, INPUT_UP } input_action_t;
+
+typedef struct input_event {
+    size_t frame;
+    input_action_t action;
+    SDL_Keycode key;
+} input_event_t;
+
+typedef struct input_script {
+    input_event_t *events;
+    size_t size;
+    size_t capacity;
+    size_t next;
+} input_script_t;
+
+typedef struct native_options {
+    bool headless;
+    size_t frames;
+    double dt;
+    const char *script_path;
+    const char *record_path;
+    const char *trace_path;
+    size_t threads;
+} native_options_t;
+
+// Frame the loop is on, read by the recorder
+static size_t current_frame = 0;
+// Fixed step returned by the wrapped time_since_last_tick(), or 0 for real time
+static double fixed_dt = 0.0;
+
+static const char *ACTION_NAMES[] = {"down", "repeat", "up"};
+
+// Defined in sdl_wrapper.c; the native link wraps it with --wrap
+double __real_time_since_last_tick(void);
+
+double __wrap_time_since_last_tick(void) {
+    if (fixed_dt > 0.0) {
+        return fixed_dt;
+    }
+    return __real_time_since_last_tick();
+}
+
+static void usage(const char *program) {
+    fprintf(stderr,
+            "usage: %s [--headless] [--frames N] [--dt SECONDS] "
+            "[--script FILE] [--record FILE] [--trace FILE] [--threads N]\n",
+            program);
+}
+
+static bool parse_options(int argc, char **argv, native_options_t *options) {
+    *options = (native_options_t){
+        .headless = false, .frames = 0, .dt = 0.0, .script_path = NULL, .record_path = NULL,
+        .trace_path = NULL, .threads = PARALLEL_DEFAULT_THREADS};
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(arg, "--headless") == 0) {
+            options->headless = true;
+            continue;
+        }
+        if (value == NULL) {
+            return false;
+        }
+        if (strcmp(arg, "--frames") == 0) {
+            options->frames = strtoull(value, NULL, 10);
+        } else if (strcmp(arg, "--dt") == 0) {
+            options->dt = strtod(value, NULL);
+            if (options->dt <= 0.0) {
+                return false;
+            }
+        } else if (strcmp(arg, "--script") == 0) {
+            options->script_path = value;
+        } else if (strcmp(arg, "--record") == 0) {
+            options->record_path = value;
+        } else if (strcmp(arg, "--trace") == 0) {
+            options->trace_path = value;
+        } else if (strcmp(arg, "--threads") == 0) {
+            options->threads = strtoull(value, NULL, 10);
+        } else {
+            return false;
+        }
+        i++;
+    }
+
+    if (options->headless && options->dt == 0.0) {
+        options->dt = HEADLESS_DT;
+    }
+    return true;
+}
+
+static bool parse_action(const char *name, input_action_t *action) {
+    for (size_t i = 0; i < sizeof(ACTION_NAMES) / sizeof(ACTION_NAMES[0]); i++) {
+        if (strcmp(name, ACTION_NAMES[i]) == 0) {
+            *action = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool script_load(input_script_t *script, const char *path) {
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        fprintf(stderr, "could not open script %s\n", path);
+        return false;
+    }
+
+    char line[128];
+    size_t line_number = 0;
+    while (fgets(line, sizeof(line), file) != NULL) {
+        line_number++;
+        if (line[0] == '#' || line[0] == '\n') {
+            continue;
+        }
+
+        size_t frame;
+        char action_name[8];
+        char key_name[32];
+        input_action_t action;
+        // Key names may contain spaces ("Keypad Enter"), so take the rest of the line
+        if (sscanf(line, "%zu %7s %31[^\n]", &frame, action_name, key_name) != 3 ||
+            !parse_action(action_name, &action)) {
+            fprintf(stderr, "%s:%zu: expected \"<frame> <down|repeat|up> <key>\"\n", path,
+                    line_number);
+            fclose(file);
+            return false;
+        }
+        SDL_Keycode key = SDL_GetKeyFromName(key_name);
+        if (key == SDLK_UNKNOWN) {
+            fprintf(stderr, "%s:%zu: unknown key \"%s\"\n", path, line_number, key_name);
+            fclose(file);
+            return false;
+        }
+        if (script->size > 0 && frame < script->events[script->size - 1].frame) {
+            fprintf(stderr, "%s:%zu: frames must not decrease\n", path, line_number);
+            fclose(file);
+            return false;
+        }
+
+        if (script->size == script->capacity) {
+            script->capacity = script->capacity > 0 ? script->capacity * 2 : 64;
+            script->events = realloc(script->events, script->capacity * sizeof(input_event_t));
+            assert(script->events != NULL);
+        }
+        script->events[script->size++] = (input_event_t){.frame = frame, .action = action, .key = key};
+    }
+
+    fclose(file);
+    return true;
+}
+
+// Queues this frame's events; sdl_is_done() hands them to the key handler
+static void script_push(input_script_t *script, size_t frame) {
+    while (script->next < script->size && script->events[script->next].frame <= frame) {
+        input_event_t *input = &script->events[script->next++];
+        SDL_Event event = {0};
+        event.type = input->action == INPUT_UP ? SDL_KEYUP : SDL_KEYDOWN;
+        event.key.state = input->action == INPUT_UP ? SDL_RELEASED : SDL_PRESSED;
+        event.key.repeat = input->action == INPUT_REPEAT;
+        event.key.timestamp = SDL_GetTicks();
+        event.key.keysym.sym = input->key;
+        event.key.keysym.scancode = SDL_GetScancodeFromKey(input->key);
+        SDL_PushEvent(&event);
+    }
+}
+
+static int record_event(void *aux, SDL_Event *event) {
+    FILE *file = aux;
+    if (event->type != SDL_KEYDOWN && event->type != SDL_KEYUP) {
+        return 0;
+    }
+    input_action_t action = event->type == SDL_KEYUP ? INPUT_UP
+                            : event->key.repeat     ? INPUT_REPEAT
+                                                    : INPUT_DOWN;
+    fprintf(file, "%zu %s %s\n", current_frame, ACTION_NAMES[action],
+            SDL_GetKeyName(event->key.keysym.sym));
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    native_options_t options;
+    if (!parse_options(argc, argv, &options)) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (options.headless) {
+        // Must be set before sdl_init() and tanks_init() start SDL
+        SDL_setenv("SDL_VIDEODRIVER", "dummy", 1);
+        SDL_setenv("SDL_AUDIODRIVER", "dummy", 1);
+        SDL_SetHint(SDL_HINT_RENDER_DRIVER, "software");
+    }
+    fixed_dt = options.dt;
+    if (options.trace_path != NULL) {
+        profile_set_output(options.trace_path);
+    }
+    parallel_set_threads(options.threads);
+
+    input_script_t script = {.events = NULL, .size = 0, .capacity = 0, .next = 0};
+    if (options.script_path != NULL && !script_load(&script, options.script_path)) {
+        free(script.events);
+        return 1;
+    }
+
+    FILE *record_file = NULL;
+    if (options.record_path != NULL) {
+        record_file = fopen(options.record_path, "w");
+        if (record_file == NULL) {
+            fprintf(stderr, "could not open %s for writing\n", options.record_path);
+            free(script.events);
+            return 1;
+        }
+    }
+
+    state_t *state = emscripten_init();
+    if (record_file != NULL) {
+        SDL_AddEventWatch(record_event, record_file);
+    }
+
+    Uint64 start = SDL_GetPerformanceCounter();
+    while (options.frames == 0 || current_frame < options.frames) {
+        script_push(&script, current_frame);
+        // sdl_is_done() in sdl_wrapper.c mallocs an event on every call
+        frame_untracked_begin();
+        bool done = sdl_is_done(state);
+        frame_untracked_end();
+        if (done) {
+            break;
+        }
+        emscripten_main(state);
+        current_frame++;
+    }
+    double elapsed = (double)(SDL_GetPerformanceCounter() - start) / SDL_GetPerformanceFrequency();
+
+    if (options.headless) {
+        fprintf(stderr, "%zu frames in %.3f s (%.1f frames/s)\n", current_frame, elapsed,
+                elapsed > 0.0 ? current_frame / elapsed : 0.0);
+    }
+
+    if (record_file != NULL) {
+        SDL_DelEventWatch(record_event, record_file);
+        fclose(record_file);
+    }
+    emscripten_free(state);
+    free(script.events);
+    return 0;
+}
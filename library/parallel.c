@@ -0,0 +1,73 @@
+#include "parallel.h"
+#include "jobs.h"
+#include "profile.h"
+#include <SDL2/SDL.h>
+#include <assert.h>
+
+typedef struct parallel_loop {
+    parallel_func_t func;
+    void *aux;
+    size_t count;
+    size_t grain;
+    size_t num_chunks;
+    SDL_atomic_t next_chunk;
+} parallel_loop_t;
+
+static size_t loop_threads = PARALLEL_DEFAULT_THREADS;
+
+// Claims and runs chunks until none are left. Runs as a job on each
+// helping thread and directly on the thread that started the loop.
+static void run_chunks(void *aux) {
+    parallel_loop_t *loop = aux;
+    while (true) {
+        size_t chunk = (size_t)SDL_AtomicAdd(&loop->next_chunk, 1);
+        if (chunk >= loop->num_chunks) {
+            return;
+        }
+        size_t start = chunk * loop->grain;
+        size_t end = start + loop->grain < loop->count ? start + loop->grain : loop->count;
+        PROFILE_ZONE("parallel chunk");
+        loop->func(loop->aux, start, end, chunk);
+    }
+}
+
+void parallel_set_threads(size_t threads) {
+    loop_threads = threads > 0 ? threads : jobs_get_workers() + 1;
+}
+
+size_t parallel_get_threads(void) {
+    return loop_threads;
+}
+
+size_t parallel_chunks(size_t count, size_t grain) {
+    assert(grain > 0);
+    return (count + grain - 1) / grain;
+}
+
+void parallel_for(size_t count, size_t grain, parallel_func_t func, void *aux) {
+    size_t num_chunks = parallel_chunks(count, grain);
+    size_t helpers = 0;
+    if (num_chunks > 1) {
+        helpers = loop_threads < num_chunks ? loop_threads - 1 : num_chunks - 1;
+        helpers = helpers < JOBS_MAX_WORKERS ? helpers : JOBS_MAX_WORKERS;
+    }
+    if (helpers == 0) {
+        for (size_t chunk = 0; chunk < num_chunks; chunk++) {
+            size_t start = chunk * grain;
+            func(aux, start, start + grain < count ? start + grain : count, chunk);
+        }
+        return;
+    }
+
+    parallel_loop_t loop = {.func = func, .aux = aux, .count = count, .grain = grain,
+                            .num_chunks = num_chunks};
+    SDL_AtomicSet(&loop.next_chunk, 0);
+    job_t jobs[JOBS_MAX_WORKERS];
+    for (size_t i = 0; i < helpers; i++) {
+        jobs[i] = (job_t){.func = run_chunks, .aux = &loop};
+    }
+    job_counter_t counter = JOB_COUNTER_INIT;
+    jobs_run(jobs, helpers, &counter);
+    run_chunks(&loop);
+    jobs_wait(&counter);
+}
@@ -0,0 +1,45 @@
+#include "perf_counters.h"
+#include <assert.h>
+#include <string.h>
+
+#define PERF_COUNTERS_MAX 32
+
+static perf_counter_t counters[PERF_COUNTERS_MAX];
+static size_t num_counters = 0;
+
+perf_counter_t *perf_counter_register(const char *name, bool per_frame) {
+    for (size_t i = 0; i < num_counters; i++) {
+        if (strcmp(counters[i].name, name) == 0) {
+            return &counters[i];
+        }
+    }
+    assert(num_counters < PERF_COUNTERS_MAX);
+    perf_counter_t *counter = &counters[num_counters++];
+    *counter = (perf_counter_t){.name = name, .value = 0, .per_frame = per_frame};
+    return counter;
+}
+
+void perf_counter_set(perf_counter_t *counter, double value) {
+    counter->value = value;
+}
+
+void perf_counter_add(perf_counter_t *counter, double amount) {
+    counter->value += amount;
+}
+
+size_t perf_counters_size(void) {
+    return num_counters;
+}
+
+perf_counter_t *perf_counters_get(size_t index) {
+    assert(index < num_counters);
+    return &counters[index];
+}
+
+void perf_counters_frame_end(void) {
+    for (size_t i = 0; i < num_counters; i++) {
+        if (counters[i].per_frame) {
+            counters[i].value = 0;
+        }
+    }
+}
@@ -0,0 +1,235 @@
+#include "perf_overlay.h"
+#include "frame_alloc.h"
+#include "perf_counters.h"
+#include "sdl_wrapper.h"
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_ttf.h>
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PERF_OVERLAY_HISTORY 120
+#define PERF_OVERLAY_MAX_LINES 24
+#define PERF_OVERLAY_LINE_LENGTH 64
+
+const int PERF_OVERLAY_FONT_SIZE = 14;
+const int PERF_OVERLAY_MARGIN = 8;
+const int PERF_OVERLAY_WIDTH = 240;
+const int PERF_OVERLAY_GRAPH_HEIGHT = 40;
+const double PERF_OVERLAY_TEXT_PERIOD = 0.25;
+const SDL_Color PERF_OVERLAY_TEXT_COLOR = {255, 255, 255, 255};
+
+// Tried in order after PERF_OVERLAY_FONT
+static const char *FALLBACK_FONTS[] = {
+    "/usr/share/fonts/truetype/dejavu/DejaVuSansMono.ttf",
+    "/usr/share/fonts/TTF/DejaVuSansMono.ttf",
+    "/System/Library/Fonts/Menlo.ttc",
+    "C:/Windows/Fonts/consola.ttf",
+};
+
+typedef struct overlay_line {
+    char text[PERF_OVERLAY_LINE_LENGTH];
+    SDL_Texture *texture;
+    int w;
+    int h;
+} overlay_line_t;
+
+typedef struct overlay {
+    bool initialized;
+    bool visible;
+    TTF_Font *font;
+    bool font_missing;
+    // Frame times in seconds, a ring of the last PERF_OVERLAY_HISTORY frames
+    double history[PERF_OVERLAY_HISTORY];
+    size_t num_samples;
+    size_t next_sample;
+    Uint64 last_frame;
+    double since_text;
+    overlay_line_t lines[PERF_OVERLAY_MAX_LINES];
+    size_t num_lines;
+    perf_counter_t *bodies;
+} overlay_t;
+
+static overlay_t overlay = {0};
+
+static int toggle_on_key(void *aux, SDL_Event *event) {
+    if (event->type == SDL_KEYDOWN && !event->key.repeat && event->key.keysym.sym == SDLK_F3) {
+        perf_overlay_toggle();
+    }
+    return 0;
+}
+
+static TTF_Font *open_font(void) {
+    if (!TTF_WasInit() && TTF_Init() != 0) {
+        return NULL;
+    }
+    TTF_Font *font = TTF_OpenFont(PERF_OVERLAY_FONT, PERF_OVERLAY_FONT_SIZE);
+    for (size_t i = 0; font == NULL && i < sizeof(FALLBACK_FONTS) / sizeof(FALLBACK_FONTS[0]); i++) {
+        font = TTF_OpenFont(FALLBACK_FONTS[i], PERF_OVERLAY_FONT_SIZE);
+    }
+    if (font == NULL) {
+        SDL_Log("perf overlay: no font found; showing the graph only\n");
+    }
+    return font;
+}
+
+static void overlay_init(void) {
+    overlay.initialized = true;
+    overlay.last_frame = SDL_GetPerformanceCounter();
+    overlay.bodies = perf_counter_register("bodies", false);
+    SDL_AddEventWatch(toggle_on_key, NULL);
+}
+
+void perf_overlay_toggle(void) {
+    overlay.visible = !overlay.visible;
+    // Redraw the text straight away
+    overlay.since_text = PERF_OVERLAY_TEXT_PERIOD;
+}
+
+bool perf_overlay_visible(void) {
+    return overlay.visible;
+}
+
+static int compare_doubles(const void *a, const void *b) {
+    double x = *(const double *) a;
+    double y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+// Sets a line's text, rendering a new texture only if it changed
+static void set_line(SDL_Renderer *renderer, size_t index, const char *text) {
+    overlay_line_t *line = &overlay.lines[index];
+    if (line->texture != NULL && strcmp(line->text, text) == 0) {
+        return;
+    }
+    snprintf(line->text, sizeof(line->text), "%s", text);
+    if (line->texture != NULL) {
+        SDL_DestroyTexture(line->texture);
+        line->texture = NULL;
+    }
+
+    // SDL_ttf and SDL allocate for the new texture
+    frame_allow_malloc();
+    SDL_Surface *surface = TTF_RenderText_Blended(overlay.font, line->text, PERF_OVERLAY_TEXT_COLOR);
+    if (surface == NULL) {
+        return;
+    }
+    line->texture = SDL_CreateTextureFromSurface(renderer, surface);
+    line->w = surface->w;
+    line->h = surface->h;
+    SDL_FreeSurface(surface);
+}
+
+static void update_text(SDL_Renderer *renderer, double p50, double p99) {
+    char text[PERF_OVERLAY_LINE_LENGTH];
+    double last = overlay.history[(overlay.next_sample + PERF_OVERLAY_HISTORY - 1) % PERF_OVERLAY_HISTORY];
+    snprintf(text, sizeof(text), "frame %.2f ms  p50 %.2f  p99 %.2f", 1e3 * last, 1e3 * p50,
+             1e3 * p99);
+    set_line(renderer, 0, text);
+
+    size_t num_counters = perf_counters_size();
+    size_t num_lines = 1;
+    for (size_t i = 0; i < num_counters && num_lines < PERF_OVERLAY_MAX_LINES; i++) {
+        perf_counter_t *counter = perf_counters_get(i);
+        snprintf(text, sizeof(text), "%s: %.0f", counter->name, counter->value);
+        set_line(renderer, num_lines++, text);
+    }
+    overlay.num_lines = num_lines;
+}
+
+static void draw_panel(SDL_Renderer *renderer, double p50, double p99) {
+    Uint8 r, g, b, a;
+    SDL_BlendMode blend;
+    SDL_GetRenderDrawColor(renderer, &r, &g, &b, &a);
+    SDL_GetRenderDrawBlendMode(renderer, &blend);
+    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+
+    int text_height = 0;
+    for (size_t i = 0; i < overlay.num_lines; i++) {
+        text_height += overlay.lines[i].h;
+    }
+    SDL_Rect panel = {
+        .x = PERF_OVERLAY_MARGIN,
+        .y = PERF_OVERLAY_MARGIN,
+        .w = PERF_OVERLAY_WIDTH,
+        .h = PERF_OVERLAY_GRAPH_HEIGHT + text_height + 2 * PERF_OVERLAY_MARGIN
+    };
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 176);
+    SDL_RenderFillRect(renderer, &panel);
+
+    // Sparkline of the frame times, oldest on the left, scaled so p99 sits
+    // near the top and spikes past it are clipped
+    double scale = p99 > 0 ? 0.9 * PERF_OVERLAY_GRAPH_HEIGHT / p99 : 0;
+    int graph_x = panel.x + PERF_OVERLAY_MARGIN;
+    int graph_bottom = panel.y + PERF_OVERLAY_MARGIN + PERF_OVERLAY_GRAPH_HEIGHT;
+    int graph_width = PERF_OVERLAY_WIDTH - 2 * PERF_OVERLAY_MARGIN;
+    SDL_Point points[PERF_OVERLAY_HISTORY];
+    size_t oldest = (overlay.next_sample + PERF_OVERLAY_HISTORY - overlay.num_samples) % PERF_OVERLAY_HISTORY;
+    for (size_t i = 0; i < overlay.num_samples; i++) {
+        double height = overlay.history[(oldest + i) % PERF_OVERLAY_HISTORY] * scale;
+        if (height > PERF_OVERLAY_GRAPH_HEIGHT) {
+            height = PERF_OVERLAY_GRAPH_HEIGHT;
+        }
+        points[i].x = graph_x + (int) (i * graph_width / (PERF_OVERLAY_HISTORY - 1));
+        points[i].y = graph_bottom - (int) height;
+    }
+    SDL_SetRenderDrawColor(renderer, 96, 96, 96, 255);
+    int p50_y = graph_bottom - (int) (p50 * scale);
+    SDL_RenderDrawLine(renderer, graph_x, p50_y, graph_x + graph_width, p50_y);
+    SDL_SetRenderDrawColor(renderer, 120, 230, 120, 255);
+    SDL_RenderDrawLines(renderer, points, (int) overlay.num_samples);
+
+    int y = graph_bottom + PERF_OVERLAY_MARGIN / 2;
+    for (size_t i = 0; i < overlay.num_lines; i++) {
+        overlay_line_t *line = &overlay.lines[i];
+        if (line->texture != NULL) {
+            SDL_Rect dst = {.x = graph_x, .y = y, .w = line->w, .h = line->h};
+            SDL_RenderCopy(renderer, line->texture, NULL, &dst);
+        }
+        y += line->h;
+    }
+
+    SDL_SetRenderDrawBlendMode(renderer, blend);
+    SDL_SetRenderDrawColor(renderer, r, g, b, a);
+}
+
+void perf_overlay_draw(scene_t *scene) {
+    if (!overlay.initialized) {
+        overlay_init();
+    }
+
+    Uint64 now = SDL_GetPerformanceCounter();
+    double frame_time = (double) (now - overlay.last_frame) / SDL_GetPerformanceFrequency();
+    overlay.last_frame = now;
+    overlay.history[overlay.next_sample] = frame_time;
+    overlay.next_sample = (overlay.next_sample + 1) % PERF_OVERLAY_HISTORY;
+    if (overlay.num_samples < PERF_OVERLAY_HISTORY) {
+        overlay.num_samples++;
+    }
+    if (scene != NULL) {
+        perf_counter_set(overlay.bodies, scene_bodies(scene));
+    }
+
+    if (overlay.visible) {
+        double sorted[PERF_OVERLAY_HISTORY];
+        memcpy(sorted, overlay.history, sizeof(sorted));
+        qsort(sorted, overlay.num_samples, sizeof(double), compare_doubles);
+        double p50 = sorted[(size_t) (0.5 * (overlay.num_samples - 1) + 0.5)];
+        double p99 = sorted[(size_t) (0.99 * (overlay.num_samples - 1) + 0.5)];
+
+        SDL_Renderer *renderer = sdl_return_renderer();
+        if (overlay.font == NULL && !overlay.font_missing) {
+            overlay.font = open_font();
+            overlay.font_missing = overlay.font == NULL;
+        }
+        overlay.since_text += frame_time;
+        if (overlay.font != NULL && overlay.since_text >= PERF_OVERLAY_TEXT_PERIOD) {
+            overlay.since_text = 0;
+            update_text(renderer, p50, p99);
+        }
+        draw_panel(renderer, p50, p99);
+    }
+
+    perf_counters_frame_end();
+}
@@ -4,12 +4,16 @@
 #include "color.h"
 #include "forces.h"
 #include "collision.h"
+#include "broadphase.h"
 #include <SDL2/SDL.h>
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include "assert.h"
 
+// Defined in forces.c
+void platform_collision(body_t *platform, body_t *body1, vector_t axis, void *aux);
+
 body_t *platform_init(list_t *shape, double mass, rgb_color_t color,
                             void *info, free_func_t info_freer) {
     body_t *platform = body_init_with_info(shape, mass, color, info, info_freer);
@@ -70,6 +74,6 @@ void platform_free(body_t *platform) {
     body_free(platform);
 }
 
-void create_platform_for_body(scene_t *scene, body_t *platform, body_t *body) {
-    create_platform_collision(scene, platform, body);
+void create_platform_for_body(broadphase_t *broadphase, body_t *platform, body_t *body) {
+    broadphase_add_collision(broadphase, platform, body, platform_collision, NULL, NULL);
 }
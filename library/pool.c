@@ -0,0 +1,96 @@
+#include "pool.h"
+#include "perf_counters.h"
+#include <assert.h>
+#include <stdalign.h>
+#include <stdlib.h>
+
+const size_t POOL_ALIGNMENT = alignof(max_align_t);
+
+// Chunks form a list, newest first; objects follow the header
+typedef struct pool_chunk {
+    struct pool_chunk *next;
+    alignas(max_align_t) unsigned char data[];
+} pool_chunk_t;
+
+// A released object holds the link to the next free one
+typedef struct free_object {
+    struct free_object *next;
+} free_object_t;
+
+typedef struct pool {
+    size_t object_size;
+    size_t chunk_objects;
+    pool_chunk_t *chunks;
+    free_object_t *free_list;
+    pool_stats_t stats;
+    perf_counter_t *counter;
+} pool_t;
+
+pool_t *pool_init(size_t object_size, size_t chunk_objects, const char *name) {
+    assert(chunk_objects > 0);
+    pool_t *pool = malloc(sizeof(pool_t));
+    assert(pool != NULL);
+    if (object_size < sizeof(free_object_t)) {
+        object_size = sizeof(free_object_t);
+    }
+    pool->object_size = (object_size + POOL_ALIGNMENT - 1) / POOL_ALIGNMENT * POOL_ALIGNMENT;
+    pool->chunk_objects = chunk_objects;
+    pool->chunks = NULL;
+    pool->free_list = NULL;
+    pool->stats = (pool_stats_t){0};
+    pool->counter = name != NULL ? perf_counter_register(name, false) : NULL;
+    return pool;
+}
+
+void pool_free(pool_t *pool) {
+    pool_chunk_t *chunk = pool->chunks;
+    while (chunk != NULL) {
+        pool_chunk_t *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    if (pool->counter != NULL) {
+        perf_counter_add(pool->counter, -(double)pool->stats.capacity);
+    }
+    free(pool);
+}
+
+// Adds a chunk and threads its objects onto the free list, first on top
+static void pool_grow(pool_t *pool) {
+    pool_chunk_t *chunk = malloc(sizeof(pool_chunk_t) + pool->chunk_objects * pool->object_size);
+    assert(chunk != NULL);
+    chunk->next = pool->chunks;
+    pool->chunks = chunk;
+    for (size_t i = pool->chunk_objects; i > 0; i--) {
+        free_object_t *object = (free_object_t *)(chunk->data + (i - 1) * pool->object_size);
+        object->next = pool->free_list;
+        pool->free_list = object;
+    }
+    pool->stats.capacity += pool->chunk_objects;
+    pool->stats.chunks++;
+    if (pool->counter != NULL) {
+        perf_counter_add(pool->counter, pool->chunk_objects);
+    }
+}
+
+void *pool_alloc(pool_t *pool) {
+    if (pool->free_list == NULL) {
+        pool_grow(pool);
+    }
+    free_object_t *object = pool->free_list;
+    pool->free_list = object->next;
+    pool->stats.used++;
+    return object;
+}
+
+void pool_release(pool_t *pool, void *object) {
+    free_object_t *released = object;
+    released->next = pool->free_list;
+    pool->free_list = released;
+    assert(pool->stats.used > 0);
+    pool->stats.used--;
+}
+
+pool_stats_t pool_get_stats(pool_t *pool) {
+    return pool->stats;
+}
@@ -0,0 +1,116 @@
+#include "profile.h"
+#include <SDL2/SDL.h>
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Events each thread keeps; older ones are overwritten
+#define PROFILE_RING_EVENTS (1 << 16)
+#define PROFILE_MAX_THREADS 64
+
+typedef struct profile_event {
+    const char *name;
+    uint64_t start;
+    uint64_t end;
+} profile_event_t;
+
+typedef struct profile_ring {
+    SDL_threadID thread;
+    // Total events recorded; the newest is at (count - 1) % PROFILE_RING_EVENTS
+    size_t count;
+    profile_event_t events[PROFILE_RING_EVENTS];
+} profile_ring_t;
+
+static profile_ring_t *rings[PROFILE_MAX_THREADS];
+static size_t num_rings = 0;
+static SDL_SpinLock rings_lock = 0;
+static const char *output_path = PROFILE_DEFAULT_OUTPUT;
+static uint64_t base_counter = 0;
+
+static _Thread_local profile_ring_t *thread_ring = NULL;
+
+static void dump_at_exit(void) {
+    profile_dump(output_path);
+}
+
+// Registers the calling thread's ring on its first zone
+static profile_ring_t *ring_for_thread(void) {
+    if (thread_ring != NULL) {
+        return thread_ring;
+    }
+    profile_ring_t *ring = malloc(sizeof(profile_ring_t));
+    assert(ring != NULL);
+    ring->thread = SDL_ThreadID();
+    ring->count = 0;
+
+    SDL_AtomicLock(&rings_lock);
+    if (num_rings == 0) {
+        base_counter = SDL_GetPerformanceCounter();
+        atexit(dump_at_exit);
+    }
+    assert(num_rings < PROFILE_MAX_THREADS);
+    rings[num_rings++] = ring;
+    SDL_AtomicUnlock(&rings_lock);
+
+    thread_ring = ring;
+    return ring;
+}
+
+profile_zone_t profile_zone_begin(const char *name) {
+    ring_for_thread();
+    return (profile_zone_t){.name = name, .start = SDL_GetPerformanceCounter()};
+}
+
+void profile_zone_end(profile_zone_t *zone) {
+    uint64_t end = SDL_GetPerformanceCounter();
+    profile_ring_t *ring = thread_ring;
+    profile_event_t *event = &ring->events[ring->count % PROFILE_RING_EVENTS];
+    event->name = zone->name;
+    event->start = zone->start;
+    event->end = end;
+    ring->count++;
+}
+
+void profile_set_output(const char *path) {
+    output_path = path;
+}
+
+bool profile_dump(const char *path) {
+    FILE *file = fopen(path, "w");
+    if (file == NULL) {
+        fprintf(stderr, "could not open %s for writing\n", path);
+        return false;
+    }
+
+    // Trace timestamps are in microseconds
+    double us_per_tick = 1e6 / (double) SDL_GetPerformanceFrequency();
+    bool first = true;
+    fprintf(file, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+
+    SDL_AtomicLock(&rings_lock);
+    for (size_t r = 0; r < num_rings; r++) {
+        profile_ring_t *ring = rings[r];
+        fprintf(file, "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %lu, "
+                      "\"args\": {\"name\": \"%s %zu\"}}",
+                first ? "" : ",\n", (unsigned long) ring->thread, r == 0 ? "main" : "worker", r);
+        first = false;
+
+        // A thread still recording may overwrite the oldest events as they are
+        // read, so a dump during a run can lose a few from each ring's start
+        size_t count = ring->count;
+        size_t oldest = count > PROFILE_RING_EVENTS ? count - PROFILE_RING_EVENTS : 0;
+        for (size_t i = oldest; i < count; i++) {
+            profile_event_t *event = &ring->events[i % PROFILE_RING_EVENTS];
+            fprintf(file, ",\n{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %lu, "
+                          "\"ts\": %.3f, \"dur\": %.3f}",
+                    event->name, (unsigned long) ring->thread,
+                    (double) (event->start - base_counter) * us_per_tick,
+                    (double) (event->end - event->start) * us_per_tick);
+        }
+    }
+    SDL_AtomicUnlock(&rings_lock);
+
+    fprintf(file, "\n]}\n");
+    fclose(file);
+    return true;
+}
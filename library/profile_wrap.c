@@ -0,0 +1,156 @@
+#include "profile.h"
+#include "collision.h"
+#include "forces.h"
+#include "perf_counters.h"
+#include "pool.h"
+#include "scene.h"
+#include "sdl_wrapper.h"
+
+/**
+ * Zones around the library entry points whose sources are not in this tree.
+ * "make native PROFILE=1" links this file and passes --wrap for each
+ * function below, so calls from other objects land here first.
+ *
+ * Force creators are timed one by one: each create_* wrapper names the
+ * creator it is about to register, and the registration wrapper puts a
+ * trampoline carrying that name in front of the real creator. The
+ * trampolines also keep the overlay's count of live force creators, and
+ * come from a pool since every bullet registers and drops a few.
+ */
+
+const size_t PROFILED_FORCER_CHUNK = 128;
+
+typedef struct profiled_forcer {
+    force_creator_t forcer;
+    void *aux;
+    free_func_t freer;
+    const char *name;
+} profiled_forcer_t;
+
+// Name for the next force creator registered on this thread
+static _Thread_local const char *pending_name = NULL;
+
+// Live force creators, shown in the performance overlay
+static perf_counter_t *forcers_counter = NULL;
+
+// Lives as long as the program; force creators are registered on one thread
+static pool_t *forcer_pool = NULL;
+
+void __real_scene_tick(scene_t *scene, double dt);
+collision_info_t __real_find_collision(list_t *shape1, list_t *shape2);
+void __real_sdl_render_scene(scene_t *scene);
+void __real_sdl_show(void);
+void __real_scene_add_force_creator(scene_t *scene, force_creator_t forcer, void *aux,
+                                    free_func_t freer);
+void __real_scene_add_bodies_force_creator(scene_t *scene, force_creator_t forcer, void *aux,
+                                           list_t *bodies, free_func_t freer);
+void __real_create_newtonian_gravity(scene_t *scene, double G, body_t *body1, body_t *body2);
+void __real_create_spring(scene_t *scene, double k, body_t *body1, body_t *body2);
+void __real_create_drag(scene_t *scene, double gamma, body_t *body);
+void __real_create_collision(scene_t *scene, body_t *body1, body_t *body2,
+                             collision_handler_t handler, void *aux, free_func_t aux_freer);
+void __real_create_destructive_collision(scene_t *scene, body_t *body1, body_t *body2);
+void __real_create_physics_collision(scene_t *scene, double elasticity, body_t *body1,
+                                     body_t *body2);
+
+void __wrap_scene_tick(scene_t *scene, double dt) {
+    PROFILE_ZONE("scene_tick");
+    __real_scene_tick(scene, dt);
+}
+
+collision_info_t __wrap_find_collision(list_t *shape1, list_t *shape2) {
+    PROFILE_ZONE("find_collision");
+    return __real_find_collision(shape1, shape2);
+}
+
+void __wrap_sdl_render_scene(scene_t *scene) {
+    PROFILE_ZONE("sdl_render_scene");
+    __real_sdl_render_scene(scene);
+}
+
+void __wrap_sdl_show(void) {
+    PROFILE_ZONE("sdl_show");
+    __real_sdl_show();
+}
+
+static void profiled_forcer_run(void *aux) {
+    profiled_forcer_t *profiled = aux;
+    PROFILE_ZONE(profiled->name);
+    profiled->forcer(profiled->aux);
+}
+
+static void profiled_forcer_free(void *aux) {
+    profiled_forcer_t *profiled = aux;
+    if (profiled->freer != NULL) {
+        profiled->freer(profiled->aux);
+    }
+    pool_release(forcer_pool, profiled);
+    perf_counter_add(forcers_counter, -1);
+}
+
+static profiled_forcer_t *profiled_forcer_init(force_creator_t forcer, void *aux,
+                                               free_func_t freer) {
+    if (forcer_pool == NULL) {
+        forcer_pool = pool_init(sizeof(profiled_forcer_t), PROFILED_FORCER_CHUNK,
+                                "force creator pool");
+        forcers_counter = perf_counter_register("force creators", false);
+    }
+    profiled_forcer_t *profiled = pool_alloc(forcer_pool);
+    profiled->forcer = forcer;
+    profiled->aux = aux;
+    profiled->freer = freer;
+    profiled->name = pending_name != NULL ? pending_name : "force creator";
+    perf_counter_add(forcers_counter, 1);
+    return profiled;
+}
+
+void __wrap_scene_add_force_creator(scene_t *scene, force_creator_t forcer, void *aux,
+                                    free_func_t freer) {
+    profiled_forcer_t *profiled = profiled_forcer_init(forcer, aux, freer);
+    __real_scene_add_force_creator(scene, profiled_forcer_run, profiled, profiled_forcer_free);
+}
+
+void __wrap_scene_add_bodies_force_creator(scene_t *scene, force_creator_t forcer, void *aux,
+                                           list_t *bodies, free_func_t freer) {
+    profiled_forcer_t *profiled = profiled_forcer_init(forcer, aux, freer);
+    __real_scene_add_bodies_force_creator(scene, profiled_forcer_run, profiled, bodies,
+                                          profiled_forcer_free);
+}
+
+void __wrap_create_newtonian_gravity(scene_t *scene, double G, body_t *body1, body_t *body2) {
+    pending_name = "newtonian_gravity";
+    __real_create_newtonian_gravity(scene, G, body1, body2);
+    pending_name = NULL;
+}
+
+void __wrap_create_spring(scene_t *scene, double k, body_t *body1, body_t *body2) {
+    pending_name = "spring";
+    __real_create_spring(scene, k, body1, body2);
+    pending_name = NULL;
+}
+
+void __wrap_create_drag(scene_t *scene, double gamma, body_t *body) {
+    pending_name = "drag";
+    __real_create_drag(scene, gamma, body);
+    pending_name = NULL;
+}
+
+void __wrap_create_collision(scene_t *scene, body_t *body1, body_t *body2,
+                             collision_handler_t handler, void *aux, free_func_t aux_freer) {
+    pending_name = "collision";
+    __real_create_collision(scene, body1, body2, handler, aux, aux_freer);
+    pending_name = NULL;
+}
+
+void __wrap_create_destructive_collision(scene_t *scene, body_t *body1, body_t *body2) {
+    pending_name = "destructive_collision";
+    __real_create_destructive_collision(scene, body1, body2);
+    pending_name = NULL;
+}
+
+void __wrap_create_physics_collision(scene_t *scene, double elasticity, body_t *body1,
+                                     body_t *body2) {
+    pending_name = "physics_collision";
+    __real_create_physics_collision(scene, elasticity, body1, body2);
+    pending_name = NULL;
+}
@@ -0,0 +1,145 @@
+#include "ptr_map.h"
+#include <assert.h>
+#include <stdlib.h>
+
+const size_t PTR_MAP_INITIAL_SIZE = 16;
+
+typedef struct ptr_slot {
+    const void *key;
+    size_t value;
+} ptr_slot_t;
+
+typedef struct ptr_map {
+    ptr_slot_t *slots;
+    size_t capacity;
+    size_t size;
+} ptr_map_t;
+
+size_t ptr_map_hash(uint64_t key) {
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    return (size_t)key;
+}
+
+bool ptr_map_can_shift(size_t i, size_t j, size_t home) {
+    if (i <= j) {
+        return home <= i || home > j;
+    }
+    return home <= i && home > j;
+}
+
+void *array_grow(void *array, size_t *capacity, size_t needed, size_t elem_size) {
+    if (needed <= *capacity) {
+        return array;
+    }
+    size_t new_capacity = *capacity > 0 ? *capacity * 2 : PTR_MAP_INITIAL_SIZE;
+    while (new_capacity < needed) {
+        new_capacity *= 2;
+    }
+    array = realloc(array, new_capacity * elem_size);
+    assert(array != NULL);
+    *capacity = new_capacity;
+    return array;
+}
+
+static size_t key_home(ptr_map_t *map, const void *key) {
+    return ptr_map_hash((uintptr_t)key) & (map->capacity - 1);
+}
+
+// Returns the key's slot, or the empty slot that ends its probe run
+static size_t slot_find(ptr_map_t *map, const void *key) {
+    size_t mask = map->capacity - 1;
+    size_t i = key_home(map, key);
+    while (map->slots[i].key != NULL && map->slots[i].key != key) {
+        i = (i + 1) & mask;
+    }
+    return i;
+}
+
+static ptr_slot_t *slots_init(size_t capacity) {
+    ptr_slot_t *slots = calloc(capacity, sizeof(ptr_slot_t));
+    assert(slots != NULL);
+    return slots;
+}
+
+ptr_map_t *ptr_map_init(size_t initial_size) {
+    ptr_map_t *map = malloc(sizeof(ptr_map_t));
+    assert(map != NULL);
+    map->capacity = PTR_MAP_INITIAL_SIZE;
+    while (map->capacity < initial_size * 2) {
+        map->capacity *= 2;
+    }
+    map->slots = slots_init(map->capacity);
+    map->size = 0;
+    return map;
+}
+
+void ptr_map_free(ptr_map_t *map) {
+    free(map->slots);
+    free(map);
+}
+
+bool ptr_map_get(ptr_map_t *map, const void *key, size_t *value) {
+    ptr_slot_t *slot = &map->slots[slot_find(map, key)];
+    if (slot->key == NULL) {
+        return false;
+    }
+    *value = slot->value;
+    return true;
+}
+
+static void rehash(ptr_map_t *map, size_t capacity) {
+    ptr_slot_t *old_slots = map->slots;
+    size_t old_capacity = map->capacity;
+    map->slots = slots_init(capacity);
+    map->capacity = capacity;
+    for (size_t i = 0; i < old_capacity; i++) {
+        if (old_slots[i].key != NULL) {
+            map->slots[slot_find(map, old_slots[i].key)] = old_slots[i];
+        }
+    }
+    free(old_slots);
+}
+
+void ptr_map_put(ptr_map_t *map, const void *key, size_t value) {
+    assert(key != NULL);
+    size_t i = slot_find(map, key);
+    if (map->slots[i].key == NULL) {
+        if ((map->size + 1) * 2 > map->capacity) {
+            rehash(map, map->capacity * 2);
+            i = slot_find(map, key);
+        }
+        map->slots[i].key = key;
+        map->size++;
+    }
+    map->slots[i].value = value;
+}
+
+void ptr_map_remove(ptr_map_t *map, const void *key) {
+    size_t i = slot_find(map, key);
+    if (map->slots[i].key == NULL) {
+        return;
+    }
+    ptr_slot_t *slots = map->slots;
+    size_t mask = map->capacity - 1;
+    for (size_t j = (i + 1) & mask; slots[j].key != NULL; j = (j + 1) & mask) {
+        if (ptr_map_can_shift(i, j, key_home(map, slots[j].key))) {
+            slots[i] = slots[j];
+            i = j;
+        }
+    }
+    slots[i].key = NULL;
+    map->size--;
+}
+
+void ptr_map_clear(ptr_map_t *map) {
+    for (size_t i = 0; i < map->capacity; i++) {
+        map->slots[i].key = NULL;
+    }
+    map->size = 0;
+}
+
+size_t ptr_map_size(ptr_map_t *map) {
+    return map->size;
+}
@@ -0,0 +1,566 @@
+#include "render_batch.h"
+#include "camera.h"
+#include "frame_alloc.h"
+#include "perf_counters.h"
+#include "profile.h"
+#include "sdl_wrapper.h"
+#include <SDL2/SDL.h>
+#include <assert.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+const size_t RENDER_BATCH_INITIAL_VERTICES = 1024;
+const size_t RENDER_BATCH_INITIAL_RUNS = 16;
+const double RENDER_BATCH_COLOR_SCALE = 255.0;
+
+// Defined in sdl_wrapper.c
+double get_scene_scale(vector_t window_center);
+
+// A span of vertices and indices submitted in one SDL_RenderGeometry call.
+// Polygon runs hold scene coordinates until the flush transforms them.
+typedef struct batch_run {
+    SDL_Texture *texture;
+    bool in_scene_space;
+    size_t first_vertex;
+    size_t num_vertices;
+    size_t first_index;
+    size_t num_indices;
+} batch_run_t;
+
+// The camera transform for the current frame. Both spaces map to pixels as
+// offset + factor * (x, +-y), and the min/max corners bound what is visible.
+typedef struct batch_view {
+    bool valid;
+    bool moved;
+    vector_t scene_offset;
+    double scene_factor;
+    vector_t sprite_offset;
+    double zoom;
+    vector_t scene_min;
+    vector_t scene_max;
+    vector_t sprite_min;
+    vector_t sprite_max;
+} batch_view_t;
+
+typedef struct render_batch {
+    SDL_Renderer *renderer;
+    SDL_Vertex *vertices;
+    // Scene-space position of each polygon vertex, parallel to vertices
+    vector_t *scene_points;
+    size_t num_vertices;
+    size_t vertex_capacity;
+    int *indices;
+    size_t num_indices;
+    size_t index_capacity;
+    batch_run_t *runs;
+    size_t num_runs;
+    size_t run_capacity;
+    // Scratch space for ear clipping
+    size_t *ear_indices;
+    size_t ear_capacity;
+    // Size of the last texture a sprite used, to skip SDL_QueryTexture
+    SDL_Texture *last_texture;
+    int last_texture_w;
+    int last_texture_h;
+    batch_view_t view;
+    render_batch_stats_t pending;
+    render_batch_stats_t stats;
+} render_batch_t;
+
+static render_batch_t *shared_batch = NULL;
+
+// Shown in the performance overlay, summed over every flush in a frame
+static perf_counter_t *draw_calls_counter = NULL;
+static perf_counter_t *culled_counter = NULL;
+
+static void ensure_vertices(render_batch_t *batch, size_t extra) {
+    size_t needed = batch->num_vertices + extra;
+    if (needed <= batch->vertex_capacity) {
+        return;
+    }
+    size_t capacity = batch->vertex_capacity * 2;
+    while (capacity < needed) {
+        capacity *= 2;
+    }
+    batch->vertices = realloc(batch->vertices, capacity * sizeof(SDL_Vertex));
+    assert(batch->vertices != NULL);
+    batch->scene_points = realloc(batch->scene_points, capacity * sizeof(vector_t));
+    assert(batch->scene_points != NULL);
+    batch->vertex_capacity = capacity;
+}
+
+static void ensure_indices(render_batch_t *batch, size_t extra) {
+    size_t needed = batch->num_indices + extra;
+    if (needed <= batch->index_capacity) {
+        return;
+    }
+    size_t capacity = batch->index_capacity * 2;
+    while (capacity < needed) {
+        capacity *= 2;
+    }
+    batch->indices = realloc(batch->indices, capacity * sizeof(int));
+    assert(batch->indices != NULL);
+    batch->index_capacity = capacity;
+}
+
+// Returns the run new geometry should go in, starting a new one if the
+// texture or coordinate space changes
+static batch_run_t *current_run(render_batch_t *batch, SDL_Texture *texture, bool in_scene_space) {
+    if (batch->num_runs > 0) {
+        batch_run_t *last = &batch->runs[batch->num_runs - 1];
+        if (last->texture == texture && last->in_scene_space == in_scene_space) {
+            return last;
+        }
+    }
+    if (batch->num_runs == batch->run_capacity) {
+        batch->run_capacity *= 2;
+        batch->runs = realloc(batch->runs, batch->run_capacity * sizeof(batch_run_t));
+        assert(batch->runs != NULL);
+    }
+    batch_run_t *run = &batch->runs[batch->num_runs++];
+    run->texture = texture;
+    run->in_scene_space = in_scene_space;
+    run->first_vertex = batch->num_vertices;
+    run->num_vertices = 0;
+    run->first_index = batch->num_indices;
+    run->num_indices = 0;
+    return run;
+}
+
+static void add_triangle(render_batch_t *batch, batch_run_t *run, size_t base,
+                         size_t a, size_t b, size_t c) {
+    // Indices are relative to the start of the run
+    size_t offset = base - run->first_vertex;
+    batch->indices[batch->num_indices++] = (int) (offset + a);
+    batch->indices[batch->num_indices++] = (int) (offset + b);
+    batch->indices[batch->num_indices++] = (int) (offset + c);
+    run->num_indices += 3;
+}
+
+static double cross(vector_t o, vector_t a, vector_t b) {
+    return (a.x - o.x) * (b.y - o.y) - (a.y - o.y) * (b.x - o.x);
+}
+
+static bool is_convex(const vector_t *points, size_t n) {
+    int sign = 0;
+    for (size_t i = 0; i < n; i++) {
+        double turn = cross(points[i], points[(i + 1) % n], points[(i + 2) % n]);
+        if (turn > 0) {
+            if (sign < 0) {
+                return false;
+            }
+            sign = 1;
+        } else if (turn < 0) {
+            if (sign > 0) {
+                return false;
+            }
+            sign = -1;
+        }
+    }
+    return true;
+}
+
+static bool point_in_triangle(vector_t p, vector_t a, vector_t b, vector_t c, double orientation) {
+    return orientation * cross(a, b, p) >= 0 && orientation * cross(b, c, p) >= 0 &&
+           orientation * cross(c, a, p) >= 0;
+}
+
+// Ear-clips a simple polygon, falling back to a fan if it is degenerate
+static void triangulate_concave(render_batch_t *batch, batch_run_t *run, size_t base,
+                                const vector_t *points, size_t n) {
+    if (batch->ear_capacity < n) {
+        batch->ear_capacity = n;
+        batch->ear_indices = realloc(batch->ear_indices, n * sizeof(size_t));
+        assert(batch->ear_indices != NULL);
+    }
+    size_t *remaining = batch->ear_indices;
+    double area = 0;
+    for (size_t i = 0; i < n; i++) {
+        remaining[i] = i;
+        area += cross(VEC_ZERO, points[i], points[(i + 1) % n]);
+    }
+    double orientation = area >= 0 ? 1.0 : -1.0;
+
+    size_t count = n;
+    size_t i = 0;
+    size_t misses = 0;
+    while (count > 3 && misses < count) {
+        size_t prev = remaining[(i + count - 1) % count];
+        size_t curr = remaining[i % count];
+        size_t next = remaining[(i + 1) % count];
+        bool ear = orientation * cross(points[prev], points[curr], points[next]) > 0;
+        for (size_t j = 0; ear && j < count; j++) {
+            size_t other = remaining[j];
+            if (other != prev && other != curr && other != next &&
+                point_in_triangle(points[other], points[prev], points[curr], points[next], orientation)) {
+                ear = false;
+            }
+        }
+        if (ear) {
+            add_triangle(batch, run, base, prev, curr, next);
+            for (size_t j = i % count; j + 1 < count; j++) {
+                remaining[j] = remaining[j + 1];
+            }
+            count--;
+            misses = 0;
+        } else {
+            i++;
+            misses++;
+        }
+    }
+    for (size_t j = 1; j + 1 < count; j++) {
+        add_triangle(batch, run, base, remaining[0], remaining[j], remaining[j + 1]);
+    }
+}
+
+render_batch_t *render_batch_init(SDL_Renderer *renderer) {
+    render_batch_t *batch = malloc(sizeof(render_batch_t));
+    assert(batch != NULL);
+    batch->renderer = renderer;
+    batch->vertex_capacity = RENDER_BATCH_INITIAL_VERTICES;
+    batch->vertices = malloc(batch->vertex_capacity * sizeof(SDL_Vertex));
+    assert(batch->vertices != NULL);
+    batch->scene_points = malloc(batch->vertex_capacity * sizeof(vector_t));
+    assert(batch->scene_points != NULL);
+    batch->num_vertices = 0;
+    batch->index_capacity = 3 * RENDER_BATCH_INITIAL_VERTICES;
+    batch->indices = malloc(batch->index_capacity * sizeof(int));
+    assert(batch->indices != NULL);
+    batch->num_indices = 0;
+    batch->run_capacity = RENDER_BATCH_INITIAL_RUNS;
+    batch->runs = malloc(batch->run_capacity * sizeof(batch_run_t));
+    assert(batch->runs != NULL);
+    batch->num_runs = 0;
+    batch->ear_indices = NULL;
+    batch->ear_capacity = 0;
+    batch->last_texture = NULL;
+    batch->last_texture_w = 0;
+    batch->last_texture_h = 0;
+    batch->view.valid = false;
+    batch->pending = (render_batch_stats_t){0};
+    batch->stats = (render_batch_stats_t){0};
+    return batch;
+}
+
+void render_batch_free(render_batch_t *batch) {
+    if (batch == shared_batch) {
+        shared_batch = NULL;
+    }
+    free(batch->vertices);
+    free(batch->scene_points);
+    free(batch->indices);
+    free(batch->runs);
+    free(batch->ear_indices);
+    free(batch);
+}
+
+render_batch_t *render_batch_shared(void) {
+    if (shared_batch == NULL) {
+        shared_batch = render_batch_init(sdl_return_renderer());
+    }
+    return shared_batch;
+}
+
+static const batch_view_t *current_view(render_batch_t *batch) {
+    batch_view_t *view = &batch->view;
+    if (view->valid) {
+        return view;
+    }
+
+    // get_window_center() in sdl_wrapper.c mallocs on every call
+    int width = 0;
+    int height = 0;
+    SDL_GetWindowSize(SDL_RenderGetWindow(batch->renderer), &width, &height);
+    vector_t window_center = {.x = width / 2.0, .y = height / 2.0};
+    double scale = get_scene_scale(window_center);
+    vector_t origin = get_window_position(VEC_ZERO, window_center);
+    camera_t camera = camera_get();
+
+    // Scene points go to origin + scale * (x, -y), sprites stay put, then both
+    // move by the camera's offset and zoom about the window's center
+    double shift_x = -scale * camera.position.x - window_center.x;
+    double shift_y = scale * camera.position.y - window_center.y;
+    view->scene_offset = (vector_t){
+        .x = window_center.x + camera.zoom * (origin.x + shift_x),
+        .y = window_center.y + camera.zoom * (origin.y + shift_y)
+    };
+    view->scene_factor = camera.zoom * scale;
+    view->sprite_offset = (vector_t){
+        .x = window_center.x + camera.zoom * shift_x,
+        .y = window_center.y + camera.zoom * shift_y
+    };
+    view->zoom = camera.zoom;
+    view->moved = camera.zoom != 1.0 || camera.position.x != 0 || camera.position.y != 0;
+
+    // Invert both maps at the window's corners
+    vector_t size = vec_multiply(2, window_center);
+    view->scene_min = (vector_t){
+        .x = -view->scene_offset.x / view->scene_factor,
+        .y = (view->scene_offset.y - size.y) / view->scene_factor
+    };
+    view->scene_max = (vector_t){
+        .x = (size.x - view->scene_offset.x) / view->scene_factor,
+        .y = view->scene_offset.y / view->scene_factor
+    };
+    view->sprite_min = vec_multiply(-1 / view->zoom, view->sprite_offset);
+    view->sprite_max = vec_multiply(1 / view->zoom, vec_subtract(size, view->sprite_offset));
+    view->valid = true;
+    return view;
+}
+
+SDL_Rect render_batch_visible_rect(render_batch_t *batch) {
+    const batch_view_t *view = current_view(batch);
+    int x = (int) floor(view->sprite_min.x);
+    int y = (int) floor(view->sprite_min.y);
+    return (SDL_Rect){
+        .x = x,
+        .y = y,
+        .w = (int) ceil(view->sprite_max.x) - x,
+        .h = (int) ceil(view->sprite_max.y) - y
+    };
+}
+
+// Reserves space for an n-gon and returns where its scene-space points go
+static vector_t *polygon_begin(render_batch_t *batch, size_t n, rgb_color_t color) {
+    ensure_vertices(batch, n);
+    ensure_indices(batch, 3 * (n - 2));
+    current_run(batch, NULL, true);
+
+    size_t base = batch->num_vertices;
+    SDL_Color vertex_color = {
+        .r = (Uint8) (color.r * RENDER_BATCH_COLOR_SCALE),
+        .g = (Uint8) (color.g * RENDER_BATCH_COLOR_SCALE),
+        .b = (Uint8) (color.b * RENDER_BATCH_COLOR_SCALE),
+        .a = 255
+    };
+    for (size_t i = 0; i < n; i++) {
+        batch->vertices[base + i].color = vertex_color;
+        batch->vertices[base + i].tex_coord = (SDL_FPoint){0, 0};
+    }
+    return &batch->scene_points[base];
+}
+
+// Triangulates the n points written after polygon_begin(), or drops them
+// if they are all on one side of the view
+static void polygon_end(render_batch_t *batch, size_t n) {
+    batch_run_t *run = &batch->runs[batch->num_runs - 1];
+    size_t base = batch->num_vertices;
+    vector_t *scene_points = &batch->scene_points[base];
+
+    const batch_view_t *view = current_view(batch);
+    vector_t min = scene_points[0];
+    vector_t max = scene_points[0];
+    for (size_t i = 1; i < n; i++) {
+        min.x = fmin(min.x, scene_points[i].x);
+        min.y = fmin(min.y, scene_points[i].y);
+        max.x = fmax(max.x, scene_points[i].x);
+        max.y = fmax(max.y, scene_points[i].y);
+    }
+    if (max.x < view->scene_min.x || min.x > view->scene_max.x ||
+        max.y < view->scene_min.y || min.y > view->scene_max.y) {
+        batch->pending.culled_polygons++;
+        return;
+    }
+
+    batch->num_vertices += n;
+    run->num_vertices += n;
+
+    if (is_convex(scene_points, n)) {
+        for (size_t i = 1; i + 1 < n; i++) {
+            add_triangle(batch, run, base, 0, i, i + 1);
+        }
+    } else {
+        triangulate_concave(batch, run, base, scene_points, n);
+    }
+    batch->pending.polygons++;
+}
+
+void render_batch_add_polygon(render_batch_t *batch, list_t *points, rgb_color_t color) {
+    size_t n = list_size(points);
+    if (n < 3) {
+        return;
+    }
+    vector_t *scene_points = polygon_begin(batch, n, color);
+    for (size_t i = 0; i < n; i++) {
+        scene_points[i] = *(vector_t *) list_get(points, i);
+    }
+    polygon_end(batch, n);
+}
+
+void render_batch_add_vertices(render_batch_t *batch, const vertex_array_t *points,
+                               rgb_color_t color) {
+    size_t n = points->size;
+    if (n < 3) {
+        return;
+    }
+    memcpy(polygon_begin(batch, n, color), points->points, n * sizeof(vector_t));
+    polygon_end(batch, n);
+}
+
+void render_batch_add_body(render_batch_t *batch, body_t *body) {
+    list_t *shape = body_get_shape(body);
+    render_batch_add_polygon(batch, shape, body_get_color(body));
+    list_free(shape);
+}
+
+void render_batch_add_shape(render_batch_t *batch, const vertex_array_t *shape, vector_t position,
+                            double rotation, rgb_color_t color) {
+    size_t n = shape->size;
+    if (n < 3) {
+        return;
+    }
+    vector_t *scene_points = polygon_begin(batch, n, color);
+    for (size_t i = 0; i < n; i++) {
+        scene_points[i] = vec_add(position, vec_rotate(shape->points[i], rotation));
+    }
+    polygon_end(batch, n);
+}
+
+void render_batch_add_scene(render_batch_t *batch, scene_t *scene) {
+    size_t body_count = scene_bodies(scene);
+    for (size_t i = 0; i < body_count; i++) {
+        body_t *body = scene_get_body(scene, i);
+        if (!body_is_removed(body)) {
+            render_batch_add_body(batch, body);
+        }
+    }
+}
+
+void render_batch_add_sprite(render_batch_t *batch, SDL_Texture *texture,
+                             const SDL_Rect *src, const SDL_Rect *dst, double angle) {
+    // Test the circle the sprite turns in, so rotation never matters
+    const batch_view_t *view = current_view(batch);
+    double radius = 0.5 * sqrt((double) dst->w * dst->w + (double) dst->h * dst->h);
+    double center_x = dst->x + dst->w / 2.0;
+    double center_y = dst->y + dst->h / 2.0;
+    if (center_x + radius < view->sprite_min.x || center_x - radius > view->sprite_max.x ||
+        center_y + radius < view->sprite_min.y || center_y - radius > view->sprite_max.y) {
+        batch->pending.culled_sprites++;
+        return;
+    }
+
+    if (texture != batch->last_texture) {
+        SDL_QueryTexture(texture, NULL, NULL, &batch->last_texture_w, &batch->last_texture_h);
+        batch->last_texture = texture;
+    }
+    double tw = batch->last_texture_w;
+    double th = batch->last_texture_h;
+    SDL_Rect full = {0, 0, batch->last_texture_w, batch->last_texture_h};
+    if (src == NULL) {
+        src = &full;
+    }
+
+    ensure_vertices(batch, 4);
+    ensure_indices(batch, 6);
+    batch_run_t *run = current_run(batch, texture, false);
+    size_t base = batch->num_vertices;
+
+    // Corners relative to the center of dst, rotated clockwise on screen
+    double half_w = dst->w / 2.0;
+    double half_h = dst->h / 2.0;
+    double cx = dst->x + half_w;
+    double cy = dst->y + half_h;
+    double radians = angle * M_PI / 180.0;
+    double c = cos(radians);
+    double s = sin(radians);
+    double corners[4][2] = {{-half_w, -half_h}, {half_w, -half_h}, {half_w, half_h}, {-half_w, half_h}};
+    double uvs[4][2] = {
+        {src->x / tw, src->y / th},
+        {(src->x + src->w) / tw, src->y / th},
+        {(src->x + src->w) / tw, (src->y + src->h) / th},
+        {src->x / tw, (src->y + src->h) / th}
+    };
+    for (size_t i = 0; i < 4; i++) {
+        SDL_Vertex *vertex = &batch->vertices[base + i];
+        vertex->position.x = (float) (cx + corners[i][0] * c - corners[i][1] * s);
+        vertex->position.y = (float) (cy + corners[i][0] * s + corners[i][1] * c);
+        vertex->color = (SDL_Color){255, 255, 255, 255};
+        vertex->tex_coord.x = (float) uvs[i][0];
+        vertex->tex_coord.y = (float) uvs[i][1];
+    }
+    batch->num_vertices += 4;
+    run->num_vertices += 4;
+    add_triangle(batch, run, base, 0, 1, 2);
+    add_triangle(batch, run, base, 0, 2, 3);
+    batch->pending.sprites++;
+}
+
+void render_batch_flush(render_batch_t *batch) {
+    PROFILE_ZONE("render_batch_flush");
+    Uint64 start = SDL_GetPerformanceCounter();
+
+    // One pass over every vertex through the camera; sprites are already in
+    // pixels and only need moving when the camera is away from its rest
+    if (batch->num_vertices > 0) {
+        const batch_view_t *view = current_view(batch);
+        for (size_t r = 0; r < batch->num_runs; r++) {
+            batch_run_t *run = &batch->runs[r];
+            SDL_Vertex *vertices = &batch->vertices[run->first_vertex];
+            if (run->in_scene_space) {
+                const vector_t *points = &batch->scene_points[run->first_vertex];
+                for (size_t i = 0; i < run->num_vertices; i++) {
+                    vertices[i].position.x = (float) (view->scene_offset.x + view->scene_factor * points[i].x);
+                    vertices[i].position.y = (float) (view->scene_offset.y - view->scene_factor * points[i].y);
+                }
+            } else if (view->moved) {
+                for (size_t i = 0; i < run->num_vertices; i++) {
+                    vertices[i].position.x = (float) (view->sprite_offset.x + view->zoom * vertices[i].position.x);
+                    vertices[i].position.y = (float) (view->sprite_offset.y + view->zoom * vertices[i].position.y);
+                }
+            }
+        }
+    }
+
+    size_t draw_calls = 0;
+    for (size_t r = 0; r < batch->num_runs; r++) {
+        batch_run_t *run = &batch->runs[r];
+        if (run->num_indices == 0) {
+            continue;
+        }
+        SDL_RenderGeometry(batch->renderer, run->texture, &batch->vertices[run->first_vertex],
+                           (int) run->num_vertices, &batch->indices[run->first_index],
+                           (int) run->num_indices);
+        draw_calls++;
+    }
+
+    batch->stats = batch->pending;
+    batch->stats.draw_calls = draw_calls;
+    batch->stats.vertices = batch->num_vertices;
+    batch->stats.triangles = batch->num_indices / 3;
+    batch->stats.submit_time = (double) (SDL_GetPerformanceCounter() - start) /
+                               (double) SDL_GetPerformanceFrequency();
+
+    if (draw_calls_counter == NULL) {
+        draw_calls_counter = perf_counter_register("draw calls", true);
+        culled_counter = perf_counter_register("culled", true);
+    }
+    perf_counter_add(draw_calls_counter, draw_calls);
+    perf_counter_add(culled_counter, batch->stats.culled_polygons + batch->stats.culled_sprites);
+
+    batch->pending = (render_batch_stats_t){0};
+    batch->view.valid = false;
+    batch->num_vertices = 0;
+    batch->num_indices = 0;
+    batch->num_runs = 0;
+}
+
+render_batch_stats_t render_batch_get_stats(render_batch_t *batch) {
+    return batch->stats;
+}
+
+void render_batch_scene(scene_t *scene) {
+    PROFILE_ZONE("render_batch_scene");
+    render_batch_t *batch = render_batch_shared();
+    render_batch_add_scene(batch, scene);
+    render_batch_flush(batch);
+    render_batch_present();
+}
+
+void render_batch_present(void) {
+    // sdl_show() gets the window center from sdl_wrapper.c, which mallocs
+    frame_untracked_begin();
+    sdl_show();
+    frame_untracked_end();
+}
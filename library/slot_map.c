@@ -0,0 +1,157 @@
+#include "slot_map.h"
+#include "body.h"
+#include <assert.h>
+#include <stdlib.h>
+
+// Marks the end of the free list
+const uint32_t SLOT_NONE = UINT32_MAX;
+
+typedef struct slot {
+    body_t *body;
+    uint32_t generation;
+    // Whether handles with the current generation refer to a live body
+    bool live;
+    uint32_t next_free;
+} slot_t;
+
+typedef struct slot_map {
+    slot_t *slots;
+    uint32_t num_slots;
+    uint32_t capacity;
+    uint32_t free_head;
+    size_t size;
+} slot_map_t;
+
+// Stored as each body's info so the map hears when the scene frees it
+typedef struct slot_info {
+    slot_map_t *map;
+    uint32_t index;
+    void *info;
+    free_func_t info_freer;
+} slot_info_t;
+
+static void slot_info_free(void *aux) {
+    slot_info_t *slot_info = aux;
+    slot_map_t *map = slot_info->map;
+    slot_t *slot = &map->slots[slot_info->index];
+
+    if (slot->live) {
+        slot->live = false;
+        slot->generation++;
+        map->size--;
+    }
+    slot->body = NULL;
+    slot->next_free = map->free_head;
+    map->free_head = slot_info->index;
+
+    if (slot_info->info_freer != NULL) {
+        slot_info->info_freer(slot_info->info);
+    }
+    free(slot_info);
+}
+
+static uint32_t slot_alloc(slot_map_t *map) {
+    if (map->free_head != SLOT_NONE) {
+        uint32_t index = map->free_head;
+        map->free_head = map->slots[index].next_free;
+        return index;
+    }
+    if (map->num_slots == map->capacity) {
+        map->capacity *= 2;
+        map->slots = realloc(map->slots, map->capacity * sizeof(slot_t));
+        assert(map->slots != NULL);
+    }
+    uint32_t index = map->num_slots++;
+    // Generation 0 is reserved for BODY_HANDLE_NULL
+    map->slots[index].generation = 1;
+    map->slots[index].body = NULL;
+    map->slots[index].live = false;
+    return index;
+}
+
+static slot_t *slot_lookup(slot_map_t *map, body_handle_t handle) {
+    if (handle.index >= map->num_slots) {
+        return NULL;
+    }
+    slot_t *slot = &map->slots[handle.index];
+    if (!slot->live || slot->generation != handle.generation) {
+        return NULL;
+    }
+    return slot;
+}
+
+slot_map_t *slot_map_init(size_t initial_size) {
+    slot_map_t *map = malloc(sizeof(slot_map_t));
+    assert(map != NULL);
+    map->capacity = initial_size > 0 ? initial_size : 1;
+    map->slots = malloc(map->capacity * sizeof(slot_t));
+    assert(map->slots != NULL);
+    map->num_slots = 0;
+    map->free_head = SLOT_NONE;
+    map->size = 0;
+    return map;
+}
+
+void slot_map_free(slot_map_t *map) {
+    free(map->slots);
+    free(map);
+}
+
+body_handle_t slot_map_body_init(slot_map_t *map, list_t *shape, double mass,
+                                 rgb_color_t color) {
+    return slot_map_body_init_with_info(map, shape, mass, color, NULL, NULL);
+}
+
+body_handle_t slot_map_body_init_with_info(slot_map_t *map, list_t *shape, double mass,
+                                           rgb_color_t color, void *info,
+                                           free_func_t info_freer) {
+    uint32_t index = slot_alloc(map);
+
+    slot_info_t *slot_info = malloc(sizeof(slot_info_t));
+    assert(slot_info != NULL);
+    slot_info->map = map;
+    slot_info->index = index;
+    slot_info->info = info;
+    slot_info->info_freer = info_freer;
+
+    slot_t *slot = &map->slots[index];
+    slot->body = body_init_with_info(shape, mass, color, slot_info, slot_info_free);
+    slot->live = true;
+    map->size++;
+
+    return (body_handle_t){.index = index, .generation = slot->generation};
+}
+
+body_t *slot_map_get(slot_map_t *map, body_handle_t handle) {
+    slot_t *slot = slot_lookup(map, handle);
+    if (slot == NULL || body_is_removed(slot->body)) {
+        return NULL;
+    }
+    return slot->body;
+}
+
+void *slot_map_get_info(slot_map_t *map, body_handle_t handle) {
+    slot_t *slot = slot_lookup(map, handle);
+    if (slot == NULL) {
+        return NULL;
+    }
+    slot_info_t *slot_info = body_get_info(slot->body);
+    return slot_info->info;
+}
+
+bool slot_map_remove(slot_map_t *map, body_handle_t handle) {
+    slot_t *slot = slot_lookup(map, handle);
+    if (slot == NULL) {
+        return false;
+    }
+    body_remove(slot->body);
+    // The slot is recycled once the scene frees the body
+    slot->live = false;
+    slot->generation++;
+    map->size--;
+    return true;
+}
+
+size_t slot_map_size(slot_map_t *map) {
+    return map->size;
+}
@@ -0,0 +1,120 @@
+#include "sprite_index.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+const size_t SPRITE_INDEX_INITIAL_CAPACITY = 64;
+
+typedef struct sprite_entry {
+    SDL_Rect rect;
+    void *item;
+    // Insertion order, so queries draw overlapping sprites as before
+    size_t order;
+} sprite_entry_t;
+
+typedef struct sprite_index {
+    // Sorted by rect.x
+    sprite_entry_t *entries;
+    size_t size;
+    size_t capacity;
+    // Widest entry, which bounds how far left of the view a hit can start
+    int max_width;
+    // Scratch space for one query's hits
+    sprite_entry_t **hits;
+    size_t hit_capacity;
+    sprite_index_stats_t stats;
+} sprite_index_t;
+
+sprite_index_t *sprite_index_init(void) {
+    sprite_index_t *index = malloc(sizeof(sprite_index_t));
+    assert(index != NULL);
+    index->capacity = SPRITE_INDEX_INITIAL_CAPACITY;
+    index->entries = malloc(index->capacity * sizeof(sprite_entry_t));
+    assert(index->entries != NULL);
+    index->size = 0;
+    index->max_width = 0;
+    index->hits = NULL;
+    index->hit_capacity = 0;
+    index->stats = (sprite_index_stats_t){0};
+    return index;
+}
+
+void sprite_index_free(sprite_index_t *index) {
+    free(index->entries);
+    free(index->hits);
+    free(index);
+}
+
+// Returns the first entry whose left edge is at least x
+static size_t lower_bound(sprite_index_t *index, int x) {
+    size_t low = 0;
+    size_t high = index->size;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (index->entries[mid].rect.x < x) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+void sprite_index_add(sprite_index_t *index, const SDL_Rect *rect, void *item) {
+    if (index->size == index->capacity) {
+        index->capacity *= 2;
+        index->entries = realloc(index->entries, index->capacity * sizeof(sprite_entry_t));
+        assert(index->entries != NULL);
+    }
+
+    // After any equal x so ties stay in insertion order
+    size_t position = lower_bound(index, rect->x + 1);
+    memmove(&index->entries[position + 1], &index->entries[position],
+            (index->size - position) * sizeof(sprite_entry_t));
+    index->entries[position] = (sprite_entry_t){.rect = *rect, .item = item, .order = index->size};
+    index->size++;
+    if (rect->w > index->max_width) {
+        index->max_width = rect->w;
+    }
+}
+
+static int compare_order(const void *a, const void *b) {
+    size_t x = (*(sprite_entry_t *const *) a)->order;
+    size_t y = (*(sprite_entry_t *const *) b)->order;
+    return (x > y) - (x < y);
+}
+
+size_t sprite_index_query(sprite_index_t *index, const SDL_Rect *view, sprite_visit_t visit,
+                          void *aux) {
+    if (index->hit_capacity < index->size) {
+        index->hit_capacity = index->capacity;
+        index->hits = realloc(index->hits, index->hit_capacity * sizeof(sprite_entry_t *));
+        assert(index->hits != NULL);
+    }
+
+    size_t hits = 0;
+    int right = view->x + view->w;
+    int bottom = view->y + view->h;
+    for (size_t i = lower_bound(index, view->x - index->max_width);
+         i < index->size && index->entries[i].rect.x < right; i++) {
+        sprite_entry_t *entry = &index->entries[i];
+        if (entry->rect.x + entry->rect.w > view->x && entry->rect.y < bottom &&
+            entry->rect.y + entry->rect.h > view->y) {
+            index->hits[hits++] = entry;
+        }
+    }
+
+    qsort(index->hits, hits, sizeof(sprite_entry_t *), compare_order);
+    for (size_t i = 0; i < hits; i++) {
+        visit(index->hits[i]->item, aux);
+    }
+
+    index->stats.entries = index->size;
+    index->stats.visited = hits;
+    index->stats.culled = index->size - hits;
+    return hits;
+}
+
+sprite_index_stats_t sprite_index_get_stats(sprite_index_t *index) {
+    return index->stats;
+}
@@ -0,0 +1,332 @@
+#include "texture_cache.h"
+#include "frame_alloc.h"
+#include "jobs.h"
+#include "perf_counters.h"
+#include "profile.h"
+#include "sdl_wrapper.h"
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_image.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+const size_t TEXTURE_CACHE_INITIAL_BUCKETS = 64;
+const size_t TEXTURE_CACHE_DEFAULT_BUDGET = 256 * 1024 * 1024;
+const size_t TEXTURE_BYTES_PER_PIXEL = 4;
+
+// Shown in the performance overlay
+static perf_counter_t *bytes_counter = NULL;
+
+typedef struct texture_handle {
+    char *path;
+    size_t hash;
+    SDL_Texture *texture;
+    size_t bytes;
+    size_t refs;
+    struct texture_handle *next_in_bucket;
+    // LRU list, most recently used at the head
+    struct texture_handle *prev;
+    struct texture_handle *next;
+    texture_cache_t *cache;
+} texture_handle_t;
+
+typedef struct texture_cache {
+    SDL_Renderer *renderer;
+    texture_handle_t **buckets;
+    size_t num_buckets;
+    texture_handle_t *lru_head;
+    texture_handle_t *lru_tail;
+    texture_cache_stats_t stats;
+} texture_cache_t;
+
+static texture_cache_t *shared_cache = NULL;
+
+// FNV-1a
+static size_t hash_path(const char *path) {
+    size_t hash = 2166136261u;
+    for (const char *c = path; *c != '\0'; c++) {
+        hash ^= (unsigned char) *c;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static void lru_unlink(texture_cache_t *cache, texture_handle_t *entry) {
+    if (entry->prev != NULL) {
+        entry->prev->next = entry->next;
+    } else {
+        cache->lru_head = entry->next;
+    }
+    if (entry->next != NULL) {
+        entry->next->prev = entry->prev;
+    } else {
+        cache->lru_tail = entry->prev;
+    }
+    entry->prev = NULL;
+    entry->next = NULL;
+}
+
+static void lru_push_front(texture_cache_t *cache, texture_handle_t *entry) {
+    entry->prev = NULL;
+    entry->next = cache->lru_head;
+    if (cache->lru_head != NULL) {
+        cache->lru_head->prev = entry;
+    }
+    cache->lru_head = entry;
+    if (cache->lru_tail == NULL) {
+        cache->lru_tail = entry;
+    }
+}
+
+static void lru_touch(texture_cache_t *cache, texture_handle_t *entry) {
+    if (cache->lru_head != entry) {
+        lru_unlink(cache, entry);
+        lru_push_front(cache, entry);
+    }
+}
+
+static void bucket_unlink(texture_cache_t *cache, texture_handle_t *entry) {
+    texture_handle_t **link = &cache->buckets[entry->hash % cache->num_buckets];
+    while (*link != entry) {
+        link = &(*link)->next_in_bucket;
+    }
+    *link = entry->next_in_bucket;
+}
+
+static void entry_free(texture_handle_t *entry) {
+    SDL_DestroyTexture(entry->texture);
+    free(entry->path);
+    free(entry);
+}
+
+static void cache_grow(texture_cache_t *cache) {
+    size_t num_buckets = cache->num_buckets * 2;
+    texture_handle_t **buckets = calloc(num_buckets, sizeof(texture_handle_t *));
+    assert(buckets != NULL);
+    for (size_t i = 0; i < cache->num_buckets; i++) {
+        texture_handle_t *entry = cache->buckets[i];
+        while (entry != NULL) {
+            texture_handle_t *next = entry->next_in_bucket;
+            size_t index = entry->hash % num_buckets;
+            entry->next_in_bucket = buckets[index];
+            buckets[index] = entry;
+            entry = next;
+        }
+    }
+    free(cache->buckets);
+    cache->buckets = buckets;
+    cache->num_buckets = num_buckets;
+}
+
+// Evicts unreferenced textures, oldest first, until the cache fits its budget
+static void cache_trim(texture_cache_t *cache) {
+    texture_handle_t *entry = cache->lru_tail;
+    while (entry != NULL && cache->stats.bytes > cache->stats.budget) {
+        texture_handle_t *prev = entry->prev;
+        if (entry->refs == 0) {
+            lru_unlink(cache, entry);
+            bucket_unlink(cache, entry);
+            cache->stats.bytes -= entry->bytes;
+            cache->stats.entries--;
+            cache->stats.evictions++;
+            entry_free(entry);
+        }
+        entry = prev;
+    }
+
+    if (bytes_counter == NULL) {
+        bytes_counter = perf_counter_register("texture cache KiB", false);
+    }
+    perf_counter_set(bytes_counter, cache->stats.bytes / 1024);
+}
+
+static texture_handle_t *cache_find(texture_cache_t *cache, const char *path, size_t hash) {
+    texture_handle_t *entry = cache->buckets[hash % cache->num_buckets];
+    while (entry != NULL) {
+        if (entry->hash == hash && strcmp(entry->path, path) == 0) {
+            return entry;
+        }
+        entry = entry->next_in_bucket;
+    }
+    return NULL;
+}
+
+// Adds a freshly loaded texture as the most recently used entry
+static texture_handle_t *cache_insert(texture_cache_t *cache, const char *path, size_t hash,
+                                      SDL_Texture *texture) {
+    int w = 0;
+    int h = 0;
+    SDL_QueryTexture(texture, NULL, NULL, &w, &h);
+
+    texture_handle_t *entry = malloc(sizeof(texture_handle_t));
+    assert(entry != NULL);
+    entry->path = malloc(strlen(path) + 1);
+    assert(entry->path != NULL);
+    strcpy(entry->path, path);
+    entry->hash = hash;
+    entry->texture = texture;
+    entry->bytes = (size_t) w * (size_t) h * TEXTURE_BYTES_PER_PIXEL;
+    entry->refs = 0;
+    entry->cache = cache;
+
+    if (cache->stats.entries + 1 > cache->num_buckets) {
+        cache_grow(cache);
+    }
+    size_t index = hash % cache->num_buckets;
+    entry->next_in_bucket = cache->buckets[index];
+    cache->buckets[index] = entry;
+    lru_push_front(cache, entry);
+    cache->stats.entries++;
+    cache->stats.bytes += entry->bytes;
+
+    // Pin the new texture while trimming so it is not evicted immediately
+    entry->refs++;
+    cache_trim(cache);
+    entry->refs--;
+    return entry;
+}
+
+static texture_handle_t *cache_lookup(texture_cache_t *cache, const char *path) {
+    size_t hash = hash_path(path);
+    texture_handle_t *entry = cache_find(cache, path, hash);
+    if (entry != NULL) {
+        cache->stats.hits++;
+        lru_touch(cache, entry);
+        return entry;
+    }
+
+    cache->stats.misses++;
+    // A miss loads from disk once; it is not a per-frame allocation
+    frame_allow_malloc();
+    PROFILE_ZONE("texture load");
+    SDL_Texture *texture = IMG_LoadTexture(cache->renderer, path);
+    if (texture == NULL) {
+        return NULL;
+    }
+    return cache_insert(cache, path, hash, texture);
+}
+
+typedef struct decode {
+    const char *path;
+    size_t hash;
+    SDL_Surface *surface;
+} decode_t;
+
+// Decodes an image on a job worker; only the upload needs the renderer
+static void decode_image(void *aux) {
+    PROFILE_ZONE("texture decode");
+    decode_t *decode = aux;
+    decode->surface = IMG_Load(decode->path);
+}
+
+texture_cache_t *texture_cache_init(SDL_Renderer *renderer, size_t budget_bytes) {
+    texture_cache_t *cache = malloc(sizeof(texture_cache_t));
+    assert(cache != NULL);
+    cache->renderer = renderer;
+    cache->num_buckets = TEXTURE_CACHE_INITIAL_BUCKETS;
+    cache->buckets = calloc(cache->num_buckets, sizeof(texture_handle_t *));
+    assert(cache->buckets != NULL);
+    cache->lru_head = NULL;
+    cache->lru_tail = NULL;
+    cache->stats = (texture_cache_stats_t){.budget = budget_bytes};
+    return cache;
+}
+
+void texture_cache_free(texture_cache_t *cache) {
+    texture_handle_t *entry = cache->lru_head;
+    while (entry != NULL) {
+        texture_handle_t *next = entry->next;
+        entry_free(entry);
+        entry = next;
+    }
+    if (cache == shared_cache) {
+        shared_cache = NULL;
+    }
+    free(cache->buckets);
+    free(cache);
+}
+
+texture_cache_t *texture_cache_shared(void) {
+    if (shared_cache == NULL) {
+        shared_cache = texture_cache_init(sdl_return_renderer(), TEXTURE_CACHE_DEFAULT_BUDGET);
+    }
+    return shared_cache;
+}
+
+texture_handle_t *texture_cache_acquire(texture_cache_t *cache, const char *path) {
+    texture_handle_t *entry = cache_lookup(cache, path);
+    if (entry != NULL) {
+        entry->refs++;
+    }
+    return entry;
+}
+
+void texture_cache_release(texture_cache_t *cache, texture_handle_t *handle) {
+    if (handle == NULL) {
+        return;
+    }
+    assert(handle->cache == cache);
+    assert(handle->refs > 0);
+    handle->refs--;
+    if (handle->refs == 0) {
+        cache_trim(cache);
+    }
+}
+
+SDL_Texture *texture_handle_get(texture_handle_t *handle) {
+    lru_touch(handle->cache, handle);
+    return handle->texture;
+}
+
+SDL_Texture *texture_cache_get(texture_cache_t *cache, const char *path) {
+    texture_handle_t *entry = cache_lookup(cache, path);
+    return entry != NULL ? entry->texture : NULL;
+}
+
+void texture_cache_preload(texture_cache_t *cache, const char *const *paths, size_t count) {
+    frame_allow_malloc();
+    decode_t *decodes = malloc(count * sizeof(decode_t));
+    assert(decodes != NULL);
+    job_t *jobs = malloc(count * sizeof(job_t));
+    assert(jobs != NULL);
+    size_t num_decodes = 0;
+    for (size_t i = 0; i < count; i++) {
+        size_t hash = hash_path(paths[i]);
+        if (cache_find(cache, paths[i], hash) == NULL) {
+            decodes[num_decodes] = (decode_t){.path = paths[i], .hash = hash, .surface = NULL};
+            jobs[num_decodes] = (job_t){.func = decode_image, .aux = &decodes[num_decodes]};
+            num_decodes++;
+        }
+    }
+    job_counter_t decoded = JOB_COUNTER_INIT;
+    jobs_run(jobs, num_decodes, &decoded);
+    jobs_wait(&decoded);
+
+    PROFILE_ZONE("texture upload");
+    for (size_t i = 0; i < num_decodes; i++) {
+        decode_t *decode = &decodes[i];
+        if (decode->surface == NULL) {
+            continue;
+        }
+        // The same path may be listed twice
+        if (cache_find(cache, decode->path, decode->hash) == NULL) {
+            SDL_Texture *texture = SDL_CreateTextureFromSurface(cache->renderer, decode->surface);
+            if (texture != NULL) {
+                cache->stats.misses++;
+                cache_insert(cache, decode->path, decode->hash, texture);
+            }
+        }
+        SDL_FreeSurface(decode->surface);
+    }
+    free(jobs);
+    free(decodes);
+}
+
+void texture_cache_set_budget(texture_cache_t *cache, size_t budget_bytes) {
+    cache->stats.budget = budget_bytes;
+    cache_trim(cache);
+}
+
+texture_cache_stats_t texture_cache_get_stats(texture_cache_t *cache) {
+    return cache->stats;
+}
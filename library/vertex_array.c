@@ -0,0 +1,38 @@
+#include "vertex_array.h"
+#include <assert.h>
+#include <stdlib.h>
+
+vertex_array_t *vertex_array_init(size_t size) {
+    vertex_array_t *array = malloc(sizeof(vertex_array_t) + size * sizeof(vector_t));
+    assert(array != NULL);
+    array->size = size;
+    return array;
+}
+
+vertex_array_t *vertex_array_init_in(arena_t *arena, size_t size) {
+    vertex_array_t *array = arena_alloc(arena, sizeof(vertex_array_t) + size * sizeof(vector_t));
+    array->size = size;
+    return array;
+}
+
+static void copy_list(vertex_array_t *array, list_t *list) {
+    for (size_t i = 0; i < array->size; i++) {
+        array->points[i] = *(vector_t *)list_get(list, i);
+    }
+}
+
+vertex_array_t *vertex_array_from_list(list_t *list) {
+    vertex_array_t *array = vertex_array_init(list_size(list));
+    copy_list(array, list);
+    return array;
+}
+
+vertex_array_t *vertex_array_from_list_in(arena_t *arena, list_t *list) {
+    vertex_array_t *array = vertex_array_init_in(arena, list_size(list));
+    copy_list(array, list);
+    return array;
+}
+
+void vertex_array_free(vertex_array_t *array) {
+    free(array);
+}
@@ -0,0 +1,107 @@
+#!/usr/bin/env python3
+"""Merges and compares microbenchmark results.
+
+The bin/bench_* programs write one JSON file per suite with --json.
+
+    bench_compare.py merge OUT SUITE.json...
+        combines suite files into one results file
+    bench_compare.py compare BASELINE CURRENT [--threshold PERCENT]
+        prints every benchmark's change and exits with status 1 if any
+        got slower or allocates more than the baseline
+
+A benchmark counts as slower when its median ns/op grows by more than the
+threshold (10% by default). Medians are used because they shrug off the
+occasional preempted sample that skews the mean. Allocations per op are
+deterministic, so any growth is flagged.
+
+Only the standard library is used so the step runs anywhere python3 does.
+"""
+
+import argparse
+import json
+import sys
+
+ALLOCS_TOLERANCE = 0.005
+
+
+def load_results(path):
+    """Returns {"suite/name": result} for a merged or single-suite file."""
+    with open(path) as f:
+        data = json.load(f)
+    suites = data["suites"] if "suites" in data else [data]
+    results = {}
+    for suite in suites:
+        for result in suite["results"]:
+            results[suite["suite"] + "/" + result["name"]] = result
+    return results
+
+
+def merge(out_path, suite_paths):
+    suites = []
+    for path in suite_paths:
+        with open(path) as f:
+            suites.append(json.load(f))
+    with open(out_path, "w") as f:
+        json.dump({"suites": suites}, f, indent=2)
+        f.write("\n")
+    return 0
+
+
+def compare(baseline_path, current_path, threshold):
+    baseline = load_results(baseline_path)
+    current = load_results(current_path)
+    regressions = 0
+
+    print(f"{'benchmark':56} {'base p50':>10} {'p50':>10} {'change':>8} {'allocs/op':>14}")
+    for key, result in current.items():
+        base = baseline.get(key)
+        if base is None:
+            print(f"{key:56} {'-':>10} {result['p50_ns']:10.1f} {'new':>8}")
+            continue
+
+        change = (result["p50_ns"] - base["p50_ns"]) / base["p50_ns"] * 100
+        slower = change > threshold
+        allocs_grew = result["allocs_per_op"] > base["allocs_per_op"] + ALLOCS_TOLERANCE
+        flags = []
+        if slower:
+            flags.append("SLOWER")
+        if allocs_grew:
+            flags.append("MORE ALLOCS")
+        regressions += bool(flags)
+
+        allocs = f"{base['allocs_per_op']:.2f}->{result['allocs_per_op']:.2f}"
+        print(f"{key:56} {base['p50_ns']:10.1f} {result['p50_ns']:10.1f} "
+              f"{change:+7.1f}% {allocs:>14} {' '.join(flags)}")
+
+    for key in baseline.keys() - current.keys():
+        print(f"{key:56} missing from {current_path}")
+
+    if regressions > 0:
+        print(f"{regressions} regression(s) against {baseline_path}")
+        return 1
+    return 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    commands = parser.add_subparsers(dest="command", required=True)
+
+    merge_parser = commands.add_parser("merge")
+    merge_parser.add_argument("out")
+    merge_parser.add_argument("suites", nargs="+")
+
+    compare_parser = commands.add_parser("compare")
+    compare_parser.add_argument("baseline")
+    compare_parser.add_argument("current")
+    compare_parser.add_argument("--threshold", type=float, default=10.0,
+                                help="percent growth in median ns/op to flag")
+
+    args = parser.parse_args()
+    if args.command == "merge":
+        return merge(args.out, args.suites)
+    return compare(args.baseline, args.current, args.threshold)
+
+
+if __name__ == "__main__":
+    sys.exit(main())
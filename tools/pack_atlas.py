@@ -0,0 +1,253 @@
+#!/usr/bin/env python3
+"""Packs the tank sprites into one atlas texture.
+
+Every tank frame under assets/tanks, plus the bullet, crater and boulder
+images, is scaled down to the size tanks.c draws it at and copied into
+assets/tank_atlas.png. The matching source rectangles are written to
+include/tank_atlas.h so the game can pick a sprite with an array lookup.
+
+Only the standard library is used so the step runs anywhere python3 does.
+Run it from the repository root (the Makefile does this for you).
+"""
+
+import struct
+import sys
+import zlib
+
+ATLAS_PNG = "assets/tank_atlas.png"
+ATLAS_HEADER = "include/tank_atlas.h"
+
+# Draw sizes, matching TANK_IMG_WIDTH, BULLET_IMG_WIDTH, CRATER_IMG_WIDTH
+# and BOULDER_IMG_WIDTH in demo/tanks.c
+TANK_WIDTH = 200
+BULLET_WIDTH = 20
+CRATER_WIDTH = 100
+BOULDER_WIDTH = 60
+
+# Empty pixels between sprites so filtering never bleeds into a neighbour
+PADDING = 2
+TANK_COLUMNS = 10
+
+HEALTH_TIERS = ["high", "mid2", "mid1", "low", "death"]
+ANGLE_TIERS = ["Low", "Mid", "High"]
+FACINGS = ["Left", "Right"]
+PLAYERS = ["1", "2"]
+
+
+def read_png(path):
+    """Decodes an 8-bit RGB or RGBA, non-interlaced PNG into RGBA bytes."""
+    with open(path, "rb") as f:
+        data = f.read()
+    if data[:8] != b"\x89PNG\r\n\x1a\n":
+        sys.exit(f"{path}: not a PNG file")
+
+    pos = 8
+    idat = []
+    while pos < len(data):
+        length, = struct.unpack(">I", data[pos:pos + 4])
+        kind = data[pos + 4:pos + 8]
+        body = data[pos + 8:pos + 8 + length]
+        if kind == b"IHDR":
+            width, height, depth, color_type, _, _, interlace = struct.unpack(">IIBBBBB", body)
+        elif kind == b"IDAT":
+            idat.append(body)
+        pos += 12 + length
+
+    if depth != 8 or color_type not in (2, 6) or interlace != 0:
+        sys.exit(f"{path}: only 8-bit non-interlaced RGB/RGBA PNGs are supported")
+
+    bpp = 4 if color_type == 6 else 3
+    stride = width * bpp
+    raw = zlib.decompress(b"".join(idat))
+    rows = []
+    prev = bytearray(stride)
+    for y in range(height):
+        start = y * (stride + 1)
+        kind = raw[start]
+        line = bytearray(raw[start + 1:start + 1 + stride])
+        if kind == 1:
+            for i in range(bpp, stride):
+                line[i] = (line[i] + line[i - bpp]) & 0xFF
+        elif kind == 2:
+            for i in range(stride):
+                line[i] = (line[i] + prev[i]) & 0xFF
+        elif kind == 3:
+            for i in range(stride):
+                left = line[i - bpp] if i >= bpp else 0
+                line[i] = (line[i] + ((left + prev[i]) >> 1)) & 0xFF
+        elif kind == 4:
+            for i in range(stride):
+                a = line[i - bpp] if i >= bpp else 0
+                b = prev[i]
+                c = prev[i - bpp] if i >= bpp else 0
+                p = a + b - c
+                pa, pb, pc = abs(p - a), abs(p - b), abs(p - c)
+                if pa <= pb and pa <= pc:
+                    pred = a
+                elif pb <= pc:
+                    pred = b
+                else:
+                    pred = c
+                line[i] = (line[i] + pred) & 0xFF
+        if bpp == 3:
+            rgba = bytearray(width * 4)
+            rgba[0::4] = line[0::3]
+            rgba[1::4] = line[1::3]
+            rgba[2::4] = line[2::3]
+            rgba[3::4] = b"\xff" * width
+            rows.append(rgba)
+        else:
+            rows.append(line)
+        prev = line
+    return width, height, rows
+
+
+def downscale(width, height, rows, out_w, out_h):
+    """Box-filters an RGBA image down to out_w x out_h.
+
+    Colour is weighted by alpha so transparent (black) pixels do not darken
+    the edges of a sprite.
+    """
+    xs = [x * width // out_w for x in range(out_w + 1)]
+    ys = [y * height // out_h for y in range(out_h + 1)]
+    out = []
+    for oy in range(out_h):
+        sums = [[0, 0, 0, 0] for _ in range(out_w)]
+        for y in range(ys[oy], ys[oy + 1]):
+            row = rows[y]
+            channels = (row[0::4], row[1::4], row[2::4], row[3::4])
+            for ox in range(out_w):
+                x0, x1 = xs[ox], xs[ox + 1]
+                cell = sums[ox]
+                for c in range(4):
+                    cell[c] += sum(channels[c][x0:x1])
+        line = bytearray(out_w * 4)
+        for ox in range(out_w):
+            r, g, b, a = sums[ox]
+            count = (xs[ox + 1] - xs[ox]) * (ys[oy + 1] - ys[oy])
+            if a > 0:
+                line[ox * 4 + 0] = min(255, r * 255 // a)
+                line[ox * 4 + 1] = min(255, g * 255 // a)
+                line[ox * 4 + 2] = min(255, b * 255 // a)
+            line[ox * 4 + 3] = a // count
+        out.append(line)
+    return out
+
+
+def write_png(path, width, height, rows):
+    def chunk(kind, body):
+        crc = zlib.crc32(kind + body) & 0xFFFFFFFF
+        return struct.pack(">I", len(body)) + kind + body + struct.pack(">I", crc)
+
+    raw = b"".join(b"\x00" + bytes(row) for row in rows)
+    with open(path, "wb") as f:
+        f.write(b"\x89PNG\r\n\x1a\n")
+        f.write(chunk(b"IHDR", struct.pack(">IIBBBBB", width, height, 8, 6, 0, 0, 0)))
+        f.write(chunk(b"IDAT", zlib.compress(raw, 9)))
+        f.write(chunk(b"IEND", b""))
+
+
+def scaled_height(path, draw_width):
+    with open(path, "rb") as f:
+        width, height = struct.unpack(">II", f.read(24)[16:24])
+    return height * draw_width // width
+
+
+def tank_path(health, angle, facing, player):
+    if health == "death":
+        return f"assets/tanks/death{player}.png"
+    return f"assets/tanks/{health}Tank{angle}{facing}{player}.png"
+
+
+def main():
+    # Tank frames, including the two death frames, share one cell size
+    frames = []
+    for health in HEALTH_TIERS[:-1]:
+        for angle in ANGLE_TIERS:
+            for facing in FACINGS:
+                for player in PLAYERS:
+                    frames.append(tank_path(health, angle, facing, player))
+    frames += [tank_path("death", None, None, player) for player in PLAYERS]
+
+    tank_height = scaled_height(frames[0], TANK_WIDTH)
+    placements = {}
+    for i, path in enumerate(frames):
+        x = PADDING + (i % TANK_COLUMNS) * (TANK_WIDTH + PADDING)
+        y = PADDING + (i // TANK_COLUMNS) * (tank_height + PADDING)
+        placements[path] = (x, y, TANK_WIDTH, tank_height)
+
+    # Projectiles and scenery go in one row below the tanks
+    rows_of_tanks = (len(frames) + TANK_COLUMNS - 1) // TANK_COLUMNS
+    x = PADDING
+    y = PADDING + rows_of_tanks * (tank_height + PADDING)
+    misc_height = 0
+    for path, draw_width in (("assets/bullet.png", BULLET_WIDTH),
+                             ("assets/crater.png", CRATER_WIDTH),
+                             ("assets/boulder.png", BOULDER_WIDTH)):
+        h = scaled_height(path, draw_width)
+        placements[path] = (x, y, draw_width, h)
+        x += draw_width + PADDING
+        misc_height = max(misc_height, h)
+
+    atlas_w = PADDING + TANK_COLUMNS * (TANK_WIDTH + PADDING)
+    atlas_h = y + misc_height + PADDING
+    atlas = [bytearray(atlas_w * 4) for _ in range(atlas_h)]
+
+    for path, (x, y, w, h) in placements.items():
+        print(f"packing {path}", file=sys.stderr)
+        src_w, src_h, src_rows = read_png(path)
+        for dy, line in enumerate(downscale(src_w, src_h, src_rows, w, h)):
+            atlas[y + dy][x * 4:(x + w) * 4] = line
+
+    write_png(ATLAS_PNG, atlas_w, atlas_h, atlas)
+
+    def rect(path):
+        return "{%d, %d, %d, %d}" % placements[path]
+
+    lines = [
+        "// Generated by tools/pack_atlas.py. Do not edit.",
+        "#ifndef __TANK_ATLAS_H__",
+        "#define __TANK_ATLAS_H__",
+        "",
+        "#include <SDL2/SDL.h>",
+        "",
+        f'#define TANK_ATLAS_PATH "{ATLAS_PNG}"',
+        "",
+        f"#define TANK_HEALTH_TIERS {len(HEALTH_TIERS)}",
+        f"#define TANK_ANGLE_TIERS {len(ANGLE_TIERS)}",
+        f"#define TANK_FACINGS {len(FACINGS)}",
+        f"#define TANK_PLAYERS {len(PLAYERS)}",
+        "",
+        "// Source rectangles in the atlas, indexed by",
+        "// [health tier: " + ", ".join(HEALTH_TIERS) + "]",
+        "// [angle tier: " + ", ".join(a.lower() for a in ANGLE_TIERS) + "]",
+        "// [facing: " + ", ".join(f.lower() for f in FACINGS) + "]",
+        "// [player: " + ", ".join(PLAYERS) + "]",
+        "// The death tier repeats the same frame for every angle and facing.",
+        "static const SDL_Rect TANK_ATLAS_TANKS[TANK_HEALTH_TIERS][TANK_ANGLE_TIERS][TANK_FACINGS][TANK_PLAYERS] = {",
+    ]
+    for health in HEALTH_TIERS:
+        lines.append("    { // " + health)
+        for angle in ANGLE_TIERS:
+            cells = []
+            for facing in FACINGS:
+                pair = ", ".join(rect(tank_path(health, angle, facing, p)) for p in PLAYERS)
+                cells.append("{" + pair + "}")
+            lines.append("        {" + ", ".join(cells) + "},")
+        lines.append("    },")
+    lines += [
+        "};",
+        "",
+        f"static const SDL_Rect TANK_ATLAS_BULLET = {rect('assets/bullet.png')};",
+        f"static const SDL_Rect TANK_ATLAS_CRATER = {rect('assets/crater.png')};",
+        f"static const SDL_Rect TANK_ATLAS_BOULDER = {rect('assets/boulder.png')};",
+        "",
+        "#endif",
+        "",
+    ]
+    with open(ATLAS_HEADER, "w") as f:
+        f.write("\n".join(lines))
+
+
+if __name__ == "__main__":
+    main()